@@ -2697,38 +2697,239 @@ int aapolygonRGBA(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy,
 /* ---- Filled Polygon */
 
 /*!
-\brief Internal helper qsort callback functions used in filled polygon drawing.
+\brief Returns a zeroed per-thread object, creating it on first use.
 
-\param a The surface to draw on.
-\param b Vertex array containing X coordinates of the points of the polygon.
+\param id The TLS slot, created on first use.
+\param size The size of the object.
+\param destroy Destructor called when the thread exits.
 
-\returns Returns 0 if a==b, a negative number if a<b or a positive number if a>b.
+\returns The object, or NULL if it can't be created.
 */
-int _gfxPrimitivesCompareInt(const void *a, const void *b)
+static void *_gfxThreadLocal(SDL_TLSID *id, size_t size, void (*destroy)(void *))
 {
-	return (*(const int *) a) - (*(const int *) b);
+	static SDL_SpinLock lock = 0;
+	SDL_TLSID slot;
+	void *data;
+
+	SDL_AtomicLock(&lock);
+	if (*id == 0)
+		*id = SDL_TLSCreate();
+	slot = *id;
+	SDL_AtomicUnlock(&lock);
+	if (slot == 0)
+		return NULL;
+
+	data = SDL_TLSGet(slot);
+	if (data == NULL) {
+		if ((data = calloc(1, size)) == NULL)
+			return NULL;
+		if (SDL_TLSSet(slot, data, destroy) < 0) {
+			free(data);
+			return NULL;
+		}
+	}
+	return data;
 }
 
 /*!
-\brief Global vertex array to use if optional parameters are not given in filledPolygonMT calls.
+\brief A polygon edge, oriented top to bottom.
+*/
+typedef struct {
+	int x1, y1;
+	int x2, y2;
+} tGfxPolyEdge;
 
-Note: Used for non-multithreaded (default) operation of filledPolygonMT.
+/*!
+\brief Scanline state for filling polygons.
+
+The non-horizontal edges are sorted by their top once per polygon. While
+scanning, the active edges are kept in the x order of the previous row, so
+restoring the order on the next row is an insertion sort over an almost
+sorted list instead of a full sort.
 */
-static int *gfxPrimitivesPolyIntsGlobal = NULL;
+struct PolygonContext {
+	tGfxPolyEdge *edges;
+	int *active;
+	int *ints;
+	int allocated;
+	int nedges;
+	int nactive;
+	int next;
+	int maxy;
+};
+
+static SDL_TLSID _gfxPolyContextTLS = 0;
 
 /*!
-\brief Flag indicating if global vertex array was already allocated.
+\brief Creates a polygon fill context.
+
+Each context has its own edge and intersection buffers, which grow to the
+largest polygon drawn with it. Threads filling polygons concurrently (for
+example into separate software renderers) should use a context each.
 
-Note: Used for non-multithreaded (default) operation of filledPolygonMT.
+\returns The new context, or NULL if out of memory.
 */
-static int gfxPrimitivesPolyAllocatedGlobal = 0;
+PolygonContext *polygonContextCreate(void)
+{
+	return (PolygonContext *) calloc(1, sizeof(PolygonContext));
+}
 
 /*!
-\brief Draw filled polygon with alpha blending (multi-threaded capable).
+\brief Frees a polygon fill context.
+
+\param ctx The context to free; may be NULL.
+*/
+void polygonContextDestroy(PolygonContext *ctx)
+{
+	if (ctx == NULL)
+		return;
+	free(ctx->edges);
+	free(ctx->active);
+	free(ctx->ints);
+	free(ctx);
+}
+
+/*!
+\brief Returns the calling thread's default polygon context.
+*/
+static PolygonContext *_gfxPolyContextGet(void)
+{
+	return (PolygonContext *) _gfxThreadLocal(&_gfxPolyContextTLS, sizeof(PolygonContext), (void (*)(void *)) polygonContextDestroy);
+}
+
+/*!
+\brief Internal helper qsort callback ordering edges by their top.
+*/
+static int _gfxPrimitivesCompareEdge(const void *a, const void *b)
+{
+	return ((const tGfxPolyEdge *) a)->y1 - ((const tGfxPolyEdge *) b)->y1;
+}
+
+/*!
+\brief Loads a polygon into a context for scanning.
+
+\param ctx The polygon context.
+\param vx Vertex array containing X coordinates of the points of the polygon.
+\param vy Vertex array containing Y coordinates of the points of the polygon.
+\param n Number of points in the vertex array.
+\param miny Returns the first row to scan.
+\param maxy Returns the last row to scan.
+
+\returns Returns 0 on success, -1 on failure.
+*/
+static int _gfxPolyScanBegin(PolygonContext *ctx, const Sint16 * vx, const Sint16 * vy, int n, int *miny, int *maxy)
+{
+	tGfxPolyEdge *edges;
+	int *active, *ints;
+	int i, ind1;
+
+	/*
+	* Grow buffers, keeping the old ones if that fails
+	*/
+	if (ctx->allocated < n) {
+		if ((edges = (tGfxPolyEdge *) realloc(ctx->edges, sizeof(tGfxPolyEdge) * n)) == NULL)
+			return -1;
+		ctx->edges = edges;
+		if ((active = (int *) realloc(ctx->active, sizeof(int) * n)) == NULL)
+			return -1;
+		ctx->active = active;
+		if ((ints = (int *) realloc(ctx->ints, sizeof(int) * n)) == NULL)
+			return -1;
+		ctx->ints = ints;
+		ctx->allocated = n;
+	}
+
+	/*
+	* Collect the non-horizontal edges and the Y extent
+	*/
+	*miny = vy[0];
+	*maxy = vy[0];
+	ctx->nedges = 0;
+	for (i = 0; i < n; i++) {
+		ind1 = (i == 0) ? n - 1 : i - 1;
+		if (vy[i] < *miny) {
+			*miny = vy[i];
+		} else if (vy[i] > *maxy) {
+			*maxy = vy[i];
+		}
+		if (vy[ind1] < vy[i]) {
+			edges = &ctx->edges[ctx->nedges++];
+			edges->x1 = vx[ind1];
+			edges->y1 = vy[ind1];
+			edges->x2 = vx[i];
+			edges->y2 = vy[i];
+		} else if (vy[ind1] > vy[i]) {
+			edges = &ctx->edges[ctx->nedges++];
+			edges->x1 = vx[i];
+			edges->y1 = vy[i];
+			edges->x2 = vx[ind1];
+			edges->y2 = vy[ind1];
+		}
+	}
+
+	qsort(ctx->edges, ctx->nedges, sizeof(tGfxPolyEdge), _gfxPrimitivesCompareEdge);
+	ctx->nactive = 0;
+	ctx->next = 0;
+	ctx->maxy = *maxy;
+	return 0;
+}
+
+/*!
+\brief Computes the sorted edge intersections of the next scanline.
+
+Rows must be scanned in increasing order starting at the 'miny' returned
+by _gfxPolyScanBegin(). An edge covers the rows from its top up to, but
+not including, its bottom; on the last row the edges ending there are kept
+so the bottom of the polygon is drawn.
 
-Note: The last two parameters are optional; but are required for multithreaded operation.  
+\param ctx The polygon context.
+\param y The row.
+
+\returns The number of intersections stored in ctx->ints, as 16.16 fixed point.
+*/
+static int _gfxPolyScanRow(PolygonContext *ctx, int y)
+{
+	tGfxPolyEdge *e;
+	int i, j, idx, x;
+
+	/*
+	* Retire edges that ended, then activate edges that start on this row
+	*/
+	j = 0;
+	for (i = 0; i < ctx->nactive; i++) {
+		e = &ctx->edges[ctx->active[i]];
+		if ((y < e->y2) || ((y == ctx->maxy) && (y == e->y2))) {
+			ctx->active[j++] = ctx->active[i];
+		}
+	}
+	ctx->nactive = j;
+	while ((ctx->next < ctx->nedges) && (ctx->edges[ctx->next].y1 <= y)) {
+		ctx->active[ctx->nactive++] = ctx->next++;
+	}
+
+	/*
+	* Intersect and restore x order with an insertion sort
+	*/
+	for (i = 0; i < ctx->nactive; i++) {
+		idx = ctx->active[i];
+		e = &ctx->edges[idx];
+		x = ((65536 * (y - e->y1)) / (e->y2 - e->y1)) * (e->x2 - e->x1) + (65536 * e->x1);
+		for (j = i; (j > 0) && (ctx->ints[j - 1] > x); j--) {
+			ctx->ints[j] = ctx->ints[j - 1];
+			ctx->active[j] = ctx->active[j - 1];
+		}
+		ctx->ints[j] = x;
+		ctx->active[j] = idx;
+	}
+
+	return ctx->nactive;
+}
+
+/*!
+\brief Draw filled polygon with alpha blending using a polygon context.
 
 \param renderer The renderer to draw on.
+\param ctx The polygon context providing the scanline buffers.
 \param vx Vertex array containing X coordinates of the points of the filled polygon.
 \param vy Vertex array containing Y coordinates of the points of the filled polygon.
 \param n Number of points in the vertex array. Minimum number is 3.
@@ -2736,32 +2937,21 @@ Note: The last two parameters are optional; but are required for multithreaded o
 \param g The green value of the filled polygon to draw. 
 \param b The blue value of the filled polygon to draw. 
 \param a The alpha value of the filled polygon to draw.
-\param polyInts Preallocated, temporary vertex array used for sorting vertices. Required for multithreaded operation; set to NULL otherwise.
-\param polyAllocated Flag indicating if temporary vertex array was allocated. Required for multithreaded operation; set to NULL otherwise.
 
 \returns Returns 0 on success, -1 on failure.
 */
-int filledPolygonRGBAMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n, Uint8 r, Uint8 g, Uint8 b, Uint8 a, int **polyInts, int *polyAllocated)
+int filledPolygonRGBACtx(SDL_Renderer * renderer, PolygonContext *ctx, const Sint16 * vx, const Sint16 * vy, int n, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
 	int result;
 	int i;
 	int y, xa, xb;
 	int miny, maxy;
-	int x1, y1;
-	int x2, y2;
-	int ind1, ind2;
 	int ints;
-	int *gfxPrimitivesPolyInts = NULL;
-	int *gfxPrimitivesPolyIntsNew = NULL;
-	int gfxPrimitivesPolyAllocated = 0;
 
 	/*
 	* Vertex array NULL check 
 	*/
-	if (vx == NULL) {
-		return (-1);
-	}
-	if (vy == NULL) {
+	if ((ctx == NULL) || (vx == NULL) || (vy == NULL)) {
 		return (-1);
 	}
 
@@ -2772,124 +2962,26 @@ int filledPolygonRGBAMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16
 		return -1;
 	}
 
-	/*
-	* Map polygon cache  
-	*/
-	if ((polyInts==NULL) || (polyAllocated==NULL)) {
-		/* Use global cache */
-		gfxPrimitivesPolyInts = gfxPrimitivesPolyIntsGlobal;
-		gfxPrimitivesPolyAllocated = gfxPrimitivesPolyAllocatedGlobal;
-	} else {
-		/* Use local cache */
-		gfxPrimitivesPolyInts = *polyInts;
-		gfxPrimitivesPolyAllocated = *polyAllocated;
-	}
-
-	/*
-	* Allocate temp array, only grow array 
-	*/
-	if (!gfxPrimitivesPolyAllocated) {
-		gfxPrimitivesPolyInts = (int *) malloc(sizeof(int) * n);
-		gfxPrimitivesPolyAllocated = n;
-	} else {
-		if (gfxPrimitivesPolyAllocated < n) {
-			gfxPrimitivesPolyIntsNew = (int *) realloc(gfxPrimitivesPolyInts, sizeof(int) * n);
-			if (!gfxPrimitivesPolyIntsNew) {
-				if (!gfxPrimitivesPolyInts) {
-					free(gfxPrimitivesPolyInts);
-					gfxPrimitivesPolyInts = NULL;
-				}
-				gfxPrimitivesPolyAllocated = 0;
-			} else {
-				gfxPrimitivesPolyInts = gfxPrimitivesPolyIntsNew;
-				gfxPrimitivesPolyAllocated = n;
-			}
-		}
-	}
-
-	/*
-	* Check temp array
-	*/
-	if (gfxPrimitivesPolyInts==NULL) {        
-		gfxPrimitivesPolyAllocated = 0;
-	}
-
-	/*
-	* Update cache variables
-	*/
-	if ((polyInts==NULL) || (polyAllocated==NULL)) { 
-		gfxPrimitivesPolyIntsGlobal =  gfxPrimitivesPolyInts;
-		gfxPrimitivesPolyAllocatedGlobal = gfxPrimitivesPolyAllocated;
-	} else {
-		*polyInts = gfxPrimitivesPolyInts;
-		*polyAllocated = gfxPrimitivesPolyAllocated;
-	}
-
-	/*
-	* Check temp array again
-	*/
-	if (gfxPrimitivesPolyInts==NULL) {        
-		return(-1);
+	if (_gfxPolyScanBegin(ctx, vx, vy, n, &miny, &maxy) < 0) {
+		return (-1);
 	}
 
 	/*
-	* Determine Y maxima 
+	* Set color 
 	*/
-	miny = vy[0];
-	maxy = vy[0];
-	for (i = 1; (i < n); i++) {
-		if (vy[i] < miny) {
-			miny = vy[i];
-		} else if (vy[i] > maxy) {
-			maxy = vy[i];
-		}
-	}
+	result = 0;
+	if (a != 255) result |= SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	result |= SDL_SetRenderDrawColor(renderer, r, g, b, a);	
 
 	/*
 	* Draw, scanning y 
 	*/
-	result = 0;
 	for (y = miny; (y <= maxy); y++) {
-		ints = 0;
-		for (i = 0; (i < n); i++) {
-			if (!i) {
-				ind1 = n - 1;
-				ind2 = 0;
-			} else {
-				ind1 = i - 1;
-				ind2 = i;
-			}
-			y1 = vy[ind1];
-			y2 = vy[ind2];
-			if (y1 < y2) {
-				x1 = vx[ind1];
-				x2 = vx[ind2];
-			} else if (y1 > y2) {
-				y2 = vy[ind1];
-				y1 = vy[ind2];
-				x2 = vx[ind1];
-				x1 = vx[ind2];
-			} else {
-				continue;
-			}
-			if ( ((y >= y1) && (y < y2)) || ((y == maxy) && (y > y1) && (y <= y2)) ) {
-				gfxPrimitivesPolyInts[ints++] = ((65536 * (y - y1)) / (y2 - y1)) * (x2 - x1) + (65536 * x1);
-			} 	    
-		}
-
-		qsort(gfxPrimitivesPolyInts, ints, sizeof(int), _gfxPrimitivesCompareInt);
-
-		/*
-		* Set color 
-		*/
-		result = 0;
-	    if (a != 255) result |= SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-		result |= SDL_SetRenderDrawColor(renderer, r, g, b, a);	
-
-		for (i = 0; (i < ints); i += 2) {
-			xa = gfxPrimitivesPolyInts[i] + 1;
+		ints = _gfxPolyScanRow(ctx, y);
+		for (i = 0; (i < ints - 1); i += 2) {
+			xa = ctx->ints[i] + 1;
 			xa = (xa >> 16) + ((xa & 32768) >> 15);
-			xb = gfxPrimitivesPolyInts[i+1] - 1;
+			xb = ctx->ints[i+1] - 1;
 			xb = (xb >> 16) + ((xb & 32768) >> 15);
 			result |= hline(renderer, xa, xb, y);
 		}
@@ -2898,6 +2990,32 @@ int filledPolygonRGBAMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16
 	return (result);
 }
 
+/*!
+\brief Draw filled polygon with alpha blending using the calling thread's polygon context.
+
+Deprecated: the last two parameters are ignored; every thread fills through
+its own context. Use filledPolygonRGBA() or filledPolygonRGBACtx() instead.
+
+\param renderer The renderer to draw on.
+\param vx Vertex array containing X coordinates of the points of the filled polygon.
+\param vy Vertex array containing Y coordinates of the points of the filled polygon.
+\param n Number of points in the vertex array. Minimum number is 3.
+\param r The red value of the filled polygon to draw. 
+\param g The green value of the filled polygon to draw. 
+\param b The blue value of the filled polygon to draw. 
+\param a The alpha value of the filled polygon to draw.
+\param polyInts Unused; may be NULL.
+\param polyAllocated Unused; may be NULL.
+
+\returns Returns 0 on success, -1 on failure.
+*/
+int filledPolygonRGBAMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n, Uint8 r, Uint8 g, Uint8 b, Uint8 a, int **polyInts, int *polyAllocated)
+{
+	(void) polyInts;
+	(void) polyAllocated;
+	return filledPolygonRGBACtx(renderer, _gfxPolyContextGet(), vx, vy, n, r, g, b, a);
+}
+
 /*!
 \brief Draw filled polygon with alpha blending.
 
@@ -2912,7 +3030,7 @@ int filledPolygonRGBAMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16
 int filledPolygonColor(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n, Uint32 color)
 {
 	Uint8 *c = (Uint8 *)&color; 
-	return filledPolygonRGBAMT(renderer, vx, vy, n, c[0], c[1], c[2], c[3], NULL, NULL);
+	return filledPolygonRGBACtx(renderer, _gfxPolyContextGet(), vx, vy, n, c[0], c[1], c[2], c[3]);
 }
 
 /*!
@@ -2931,7 +3049,7 @@ int filledPolygonColor(SDL_Renderer * renderer, const Sint16 * vx, const Sint16
 */
 int filledPolygonRGBA(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
-	return filledPolygonRGBAMT(renderer, vx, vy, n, r, g, b, a, NULL, NULL);
+	return filledPolygonRGBACtx(renderer, _gfxPolyContextGet(), vx, vy, n, r, g, b, a);
 }
 
 /* ---- Textured Polygon */
@@ -3035,9 +3153,10 @@ int _HLineTextured(SDL_Renderer *renderer, Sint16 x1, Sint16 x2, Sint16 y, SDL_T
 }
 
 /*!
-\brief Draws a polygon filled with the given texture (Multi-Threading Capable). 
+\brief Draws a polygon filled with the given texture using a polygon context.
 
 \param renderer The renderer to draw on.
+\param ctx The polygon context providing the scanline buffers.
 \param vx array of x vector components
 \param vy array of x vector components
 \param n the amount of vectors in the vx and vy array
@@ -3045,108 +3164,28 @@ int _HLineTextured(SDL_Renderer *renderer, Sint16 x1, Sint16 x2, Sint16 y, SDL_T
 \param texture_dx the offset of the texture relative to the screeen. If you move the polygon 10 pixels 
 to the left and want the texture to apear the same you need to increase the texture_dx value
 \param texture_dy see texture_dx
-\param polyInts Preallocated temp array storage for vertex sorting (used for multi-threaded operation)
-\param polyAllocated Flag indicating oif the temp array was allocated (used for multi-threaded operation)
 
 \returns Returns 0 on success, -1 on failure.
 */
-int texturedPolygonMT(SDL_Renderer *renderer, const Sint16 * vx, const Sint16 * vy, int n, 
-	SDL_Surface * texture, int texture_dx, int texture_dy, int **polyInts, int *polyAllocated)
+int texturedPolygonCtx(SDL_Renderer *renderer, PolygonContext *ctx, const Sint16 * vx, const Sint16 * vy, int n, 
+	SDL_Surface * texture, int texture_dx, int texture_dy)
 {
 	int result;
 	int i;
 	int y, xa, xb;
-	int minx,maxx,miny, maxy;
-	int x1, y1;
-	int x2, y2;
-	int ind1, ind2;
+	int miny, maxy;
 	int ints;
-	int *gfxPrimitivesPolyInts = NULL;
-	int *gfxPrimitivesPolyIntsTemp = NULL;
-	int gfxPrimitivesPolyAllocated = 0;
 	SDL_Texture *textureAsTexture = NULL;
 
 	/*
 	* Sanity check number of edges
 	*/
-	if (n < 3) {
+	if ((ctx == NULL) || (n < 3)) {
 		return -1;
 	}
 
-	/*
-	* Map polygon cache  
-	*/
-	if ((polyInts==NULL) || (polyAllocated==NULL)) {
-		/* Use global cache */
-		gfxPrimitivesPolyInts = gfxPrimitivesPolyIntsGlobal;
-		gfxPrimitivesPolyAllocated = gfxPrimitivesPolyAllocatedGlobal;
-	} else {
-		/* Use local cache */
-		gfxPrimitivesPolyInts = *polyInts;
-		gfxPrimitivesPolyAllocated = *polyAllocated;
-	}
-
-	/*
-	* Allocate temp array, only grow array 
-	*/
-	if (!gfxPrimitivesPolyAllocated) {
-		gfxPrimitivesPolyInts = (int *) malloc(sizeof(int) * n);
-		gfxPrimitivesPolyAllocated = n;
-	} else {
-		if (gfxPrimitivesPolyAllocated < n) {
-			gfxPrimitivesPolyIntsTemp = (int *) realloc(gfxPrimitivesPolyInts, sizeof(int) * n);
-			if (gfxPrimitivesPolyIntsTemp == NULL) {
-				/* Realloc failed - keeps original memory block, but fails this operation */
-				return(-1);
-			}
-			gfxPrimitivesPolyInts = gfxPrimitivesPolyIntsTemp;
-			gfxPrimitivesPolyAllocated = n;
-		}
-	}
-
-	/*
-	* Check temp array
-	*/
-	if (gfxPrimitivesPolyInts==NULL) {        
-		gfxPrimitivesPolyAllocated = 0;
-	}
-
-	/*
-	* Update cache variables
-	*/
-	if ((polyInts==NULL) || (polyAllocated==NULL)) { 
-		gfxPrimitivesPolyIntsGlobal =  gfxPrimitivesPolyInts;
-		gfxPrimitivesPolyAllocatedGlobal = gfxPrimitivesPolyAllocated;
-	} else {
-		*polyInts = gfxPrimitivesPolyInts;
-		*polyAllocated = gfxPrimitivesPolyAllocated;
-	}
-
-	/*
-	* Check temp array again
-	*/
-	if (gfxPrimitivesPolyInts==NULL) {        
-		return(-1);
-	}
-
-	/*
-	* Determine X,Y minima,maxima 
-	*/
-	miny = vy[0];
-	maxy = vy[0];
-	minx = vx[0];
-	maxx = vx[0];
-	for (i = 1; (i < n); i++) {
-		if (vy[i] < miny) {
-			miny = vy[i];
-		} else if (vy[i] > maxy) {
-			maxy = vy[i];
-		}
-		if (vx[i] < minx) {
-			minx = vx[i];
-		} else if (vx[i] > maxx) {
-			maxx = vx[i];
-		}
+	if (_gfxPolyScanBegin(ctx, vx, vy, n, &miny, &maxy) < 0) {
+		return (-1);
 	}
 
     /* Create texture for drawing */
@@ -3162,39 +3201,11 @@ int texturedPolygonMT(SDL_Renderer *renderer, const Sint16 * vx, const Sint16 *
 	*/
 	result = 0;
 	for (y = miny; (y <= maxy); y++) {
-		ints = 0;
-		for (i = 0; (i < n); i++) {
-			if (!i) {
-				ind1 = n - 1;
-				ind2 = 0;
-			} else {
-				ind1 = i - 1;
-				ind2 = i;
-			}
-			y1 = vy[ind1];
-			y2 = vy[ind2];
-			if (y1 < y2) {
-				x1 = vx[ind1];
-				x2 = vx[ind2];
-			} else if (y1 > y2) {
-				y2 = vy[ind1];
-				y1 = vy[ind2];
-				x2 = vx[ind1];
-				x1 = vx[ind2];
-			} else {
-				continue;
-			}
-			if ( ((y >= y1) && (y < y2)) || ((y == maxy) && (y > y1) && (y <= y2)) ) {
-				gfxPrimitivesPolyInts[ints++] = ((65536 * (y - y1)) / (y2 - y1)) * (x2 - x1) + (65536 * x1);
-			} 
-		}
-
-		qsort(gfxPrimitivesPolyInts, ints, sizeof(int), _gfxPrimitivesCompareInt);
-
-		for (i = 0; (i < ints); i += 2) {
-			xa = gfxPrimitivesPolyInts[i] + 1;
+		ints = _gfxPolyScanRow(ctx, y);
+		for (i = 0; (i < ints - 1); i += 2) {
+			xa = ctx->ints[i] + 1;
 			xa = (xa >> 16) + ((xa & 32768) >> 15);
-			xb = gfxPrimitivesPolyInts[i+1] - 1;
+			xb = ctx->ints[i+1] - 1;
 			xb = (xb >> 16) + ((xb & 32768) >> 15);
 			result |= _HLineTextured(renderer, xa, xb, y, textureAsTexture, texture->w, texture->h, texture_dx, texture_dy);
 		}
@@ -3206,10 +3217,37 @@ int texturedPolygonMT(SDL_Renderer *renderer, const Sint16 * vx, const Sint16 *
 	return (result);
 }
 
+/*!
+\brief Draws a polygon filled with the given texture using the calling thread's polygon context.
+
+Deprecated: the last two parameters are ignored; every thread fills through
+its own context. Use texturedPolygon() or texturedPolygonCtx() instead.
+
+\param renderer The renderer to draw on.
+\param vx array of x vector components
+\param vy array of x vector components
+\param n the amount of vectors in the vx and vy array
+\param texture the sdl surface to use to fill the polygon
+\param texture_dx the offset of the texture relative to the screeen. If you move the polygon 10 pixels 
+to the left and want the texture to apear the same you need to increase the texture_dx value
+\param texture_dy see texture_dx
+\param polyInts Unused; may be NULL.
+\param polyAllocated Unused; may be NULL.
+
+\returns Returns 0 on success, -1 on failure.
+*/
+int texturedPolygonMT(SDL_Renderer *renderer, const Sint16 * vx, const Sint16 * vy, int n, 
+	SDL_Surface * texture, int texture_dx, int texture_dy, int **polyInts, int *polyAllocated)
+{
+	(void) polyInts;
+	(void) polyAllocated;
+	return texturedPolygonCtx(renderer, _gfxPolyContextGet(), vx, vy, n, texture, texture_dx, texture_dy);
+}
+
 /*!
 \brief Draws a polygon filled with the given texture. 
 
-This standard version is calling multithreaded versions with NULL cache parameters.
+Fills through the calling thread's polygon context.
 
 \param renderer The renderer to draw on.
 \param vx array of x vector components
@@ -3227,7 +3265,7 @@ int texturedPolygon(SDL_Renderer *renderer, const Sint16 * vx, const Sint16 * vy
 	/*
 	* Draw
 	*/
-	return (texturedPolygonMT(renderer, vx, vy, n, texture, texture_dx, texture_dy, NULL, NULL));
+	return (texturedPolygonCtx(renderer, _gfxPolyContextGet(), vx, vy, n, texture, texture_dx, texture_dy));
 }
 
 /* ---- Character */
@@ -3259,6 +3297,51 @@ static Uint32 charHeightLocal = 8;
 
 /* ---- Bezier curve */
 
+/*!
+\brief Internal function to evaluate a bezier curve of the given degree at 't' in [0, 1].
+
+Uses the Horner form of the Bernstein polynomial in t/(1-t), which costs
+O(n) per point; for t > 0.5 the curve is evaluated backwards so the ratio
+stays at most 1.
+
+\param data Array of degree+1 control values.
+\param degree Degree of the curve.
+\param t Position on the curve.
+
+\returns Interpolated value at position t.
+*/
+static double _bezierBernstein(const double *data, int degree, double t)
+{
+	double s, ratio, sn, binom, result;
+	int k, reverse;
+
+	if (t <= 0.0) {
+		return data[0];
+	}
+	if (t >= 1.0) {
+		return data[degree];
+	}
+
+	reverse = (t > 0.5);
+	if (reverse) {
+		t = 1.0 - t;
+	}
+	s = 1.0 - t;
+	ratio = t / s;
+
+	/* sum C(n,k) ratio^k P(k), highest term first, then scale by s^n */
+	binom = 1.0;
+	sn = 1.0;
+	result = reverse ? data[0] : data[degree];
+	for (k = degree; k > 0; k--) {
+		binom = binom * k / (double)(degree - k + 1);
+		result = result * ratio + binom * (reverse ? data[degree - k + 1] : data[k - 1]);
+		sn *= s;
+	}
+
+	return (result * sn);
+}
+
 /*!
 \brief Internal function to calculate bezier interpolator of data array with ndata values at position 't'.
 
@@ -3270,10 +3353,6 @@ static Uint32 charHeightLocal = 8;
 */
 double _evaluateBezier (double *data, int ndata, double t) 
 {
-	double mu, result;
-	int n,k,kn,nn,nkn;
-	double blend,muk,munk;
-
 	/* Sanity check bounds */
 	if (t<0.0) {
 		return(data[0]);
@@ -3283,36 +3362,90 @@ double _evaluateBezier (double *data, int ndata, double t)
 	}
 
 	/* Adjust t to the range 0.0 to 1.0 */ 
-	mu=t/(double)ndata;
-
-	/* Calculate interpolate */
-	n=ndata-1;
-	result=0.0;
-	muk = 1;
-	munk = pow(1-mu,(double)n);
-	for (k=0;k<=n;k++) {
-		nn = n;
-		kn = k;
-		nkn = n - k;
-		blend = muk * munk;
-		muk *= mu;
-		munk /= (1-mu);
-		while (nn >= 1) {
-			blend *= nn;
-			nn--;
-			if (kn > 1) {
-				blend /= (double)kn;
-				kn--;
-			}
-			if (nkn > 1) {
-				blend /= (double)nkn;
-				nkn--;
-			}
-		}
-		result += data[k] * blend;
+	return _bezierBernstein(data, ndata - 1, t / (double)ndata);
+}
+
+/*!
+\brief Incremental evaluator of a bezier curve at evenly spaced positions.
+
+Curves up to cubic are stepped by forward differencing (three additions per
+point); higher degrees, where forward differences lose precision, fall back
+to _bezierBernstein().
+*/
+typedef struct {
+	const double *data;
+	int degree;
+	int step, steps;
+	double fd[4];
+} tGfxBezierIter;
+
+/*!
+\brief Internal function to start evaluating a bezier curve at t = 0, 1/steps, ..., 1.
+
+\param it The iterator to set up.
+\param data Array of ndata control values; must stay valid while iterating.
+\param ndata Number of control values.
+\param steps Number of steps from t = 0 to t = 1.
+*/
+static void _bezierIterInit(tGfxBezierIter *it, const double *data, int ndata, int steps)
+{
+	double a = 0.0, b = 0.0, c = 0.0, h, h2, h3;
+
+	it->data = data;
+	it->degree = ndata - 1;
+	it->step = 0;
+	it->steps = steps;
+	if (it->degree > 3) {
+		return;
 	}
 
-	return (result);
+	/* Power basis a t^3 + b t^2 + c t + data[0] */
+	switch (it->degree) {
+	case 3:
+		a = -data[0] + 3.0 * data[1] - 3.0 * data[2] + data[3];
+		b = 3.0 * data[0] - 6.0 * data[1] + 3.0 * data[2];
+		c = 3.0 * (data[1] - data[0]);
+		break;
+	case 2:
+		b = data[0] - 2.0 * data[1] + data[2];
+		c = 2.0 * (data[1] - data[0]);
+		break;
+	case 1:
+		c = data[1] - data[0];
+		break;
+	}
+
+	h = 1.0 / (double)steps;
+	h2 = h * h;
+	h3 = h2 * h;
+	it->fd[0] = data[0];
+	it->fd[1] = a * h3 + b * h2 + c * h;
+	it->fd[2] = 6.0 * a * h3 + 2.0 * b * h2;
+	it->fd[3] = 6.0 * a * h3;
+}
+
+/*!
+\brief Internal function returning the next value of a bezier iterator.
+
+\returns The value at the current step; the last control value once t reaches 1.
+*/
+static double _bezierIterNext(tGfxBezierIter *it)
+{
+	double v;
+
+	if (it->step >= it->steps) {
+		v = it->data[it->degree];
+	} else if (it->degree > 3) {
+		v = _bezierBernstein(it->data, it->degree, (double)it->step / (double)it->steps);
+	} else {
+		v = it->fd[0];
+		it->fd[0] += it->fd[1];
+		it->fd[1] += it->fd[2];
+		it->fd[2] += it->fd[3];
+	}
+	it->step++;
+
+	return (v);
 }
 
 /*!
@@ -3352,7 +3485,8 @@ int bezierRGBA(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, in
 {
 	int result;
 	int i;
-	double *x, *y, t, stepsize;
+	double *x, *y;
+	tGfxBezierIter itx, ity;
 	Sint16 x1, y1, x2, y2;
 
 	/*
@@ -3365,11 +3499,6 @@ int bezierRGBA(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, in
 		return (-1);
 	}
 
-	/*
-	* Variable setup 
-	*/
-	stepsize=(double)1.0/(double)s;
-
 	/* Transfer vertices into float arrays */
 	if ((x=(double *)malloc(sizeof(double)*(n+1)))==NULL) {
 		return(-1);
@@ -3395,13 +3524,13 @@ int bezierRGBA(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, in
 	/*
 	* Draw 
 	*/
-	t=0.0;
-	x1=(Sint16)lrint(_evaluateBezier(x,n+1,t));
-	y1=(Sint16)lrint(_evaluateBezier(y,n+1,t));
-	for (i = 0; i <= (n*s); i++) {
-		t += stepsize;
-		x2=(Sint16)_evaluateBezier(x,n,t);
-		y2=(Sint16)_evaluateBezier(y,n,t);
+	_bezierIterInit(&itx, x, n, n*s);
+	_bezierIterInit(&ity, y, n, n*s);
+	x1=(Sint16)lrint(_bezierIterNext(&itx));
+	y1=(Sint16)lrint(_bezierIterNext(&ity));
+	for (i = 0; i < (n*s); i++) {
+		x2=(Sint16)_bezierIterNext(&itx);
+		y2=(Sint16)_bezierIterNext(&ity);
 		result |= line(renderer, x1, y1, x2, y2);
 		x1 = x2;
 		y1 = y2;
@@ -4149,9 +4278,9 @@ int thickCircleColor(SDL_Renderer * renderer, Sint16 x, Sint16 y, Sint16 rad, Ui
 int filledPolyBezierRGBA(SDL_Renderer * renderer, const Sint16 *x, const Sint16 *y, int n, int s, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
 	int i, j, nbeziers, nverts, result;
-	double t, stepsize;
 	double x1, y1, x2, y2 ;
 	double *dx, *dy ;
+	tGfxBezierIter itx, ity ;
 	Sint16 *vx, *vy ;
 
 	// Sanity check 
@@ -4184,17 +4313,16 @@ int filledPolyBezierRGBA(SDL_Renderer * renderer, const Sint16 *x, const Sint16
 	vy = vx + nverts ;
 
 	// Draw Beziers
-	stepsize = 1.0 / (double)s ;
 	for (j = 0; j < nbeziers; j++)
 	    {
-		t = 0.0 ;
-		x1 = _evaluateBezier(dx + j * 3, 4, t) ;
-		y1 = _evaluateBezier(dy + j * 3, 4, t) ;
+		_bezierIterInit(&itx, dx + j * 3, 4, 4*s) ;
+		_bezierIterInit(&ity, dy + j * 3, 4, 4*s) ;
+		x1 = _bezierIterNext(&itx) ;
+		y1 = _bezierIterNext(&ity) ;
 		for (i = 0; i < 4*s; i++)
 		    {
-			t += stepsize ;
-			x2 = _evaluateBezier(dx + j * 3, 4, t) ;
-			y2 = _evaluateBezier(dy + j * 3, 4, t) ;
+			x2 = _bezierIterNext(&itx) ;
+			y2 = _bezierIterNext(&ity) ;
 
 			vx[i + j * s * 4] = floor(x1 + 0.5) ;
 			vy[i + j * s * 4] = floor(y1 + 0.5) ;
@@ -4361,6 +4489,176 @@ int aaFilledEllipseColor(SDL_Renderer * renderer, float cx, float cy, float rx,
 	return aaFilledEllipseRGBA(renderer, cx, cy, rx, ry, c[0], c[1], c[2], c[3]);
 }
 
+/* ---- Scratch arena */
+
+/*!
+\brief Alignment of scratch allocations.
+*/
+#define SCRATCH_ALIGN 16
+
+/*!
+\brief Per-thread bump arena for the temporary arrays of the AA primitives.
+
+Allocations are released in reverse order. Requests that don't fit the block
+fall back to malloc(); once everything is released the block is regrown to
+the high-water mark, so repeated draws settle on a single allocation.
+*/
+typedef struct {
+	char *base;
+	size_t size;
+	size_t used;
+	size_t live;
+	size_t highwater;
+	size_t misses;
+} tGfxScratch;
+
+static SDL_TLSID _gfxScratchTLS = 0;
+
+static void _gfxScratchDestroy(void *data)
+{
+	tGfxScratch *scratch = (tGfxScratch *) data;
+
+	free(scratch->base);
+	free(scratch);
+}
+
+/*!
+\brief Returns the calling thread's scratch arena, creating it on first use.
+
+\returns The arena, or NULL if it can't be created.
+*/
+static tGfxScratch *_gfxScratchGet(void)
+{
+	return (tGfxScratch *) _gfxThreadLocal(&_gfxScratchTLS, sizeof(tGfxScratch), _gfxScratchDestroy);
+}
+
+/*!
+\brief Allocates temporary memory from the calling thread's scratch arena.
+
+\param size Number of bytes.
+
+\returns The memory, or NULL if out of memory. Release it with _gfxScratchFree().
+*/
+static void *_gfxScratchAlloc(size_t size)
+{
+	tGfxScratch *scratch = _gfxScratchGet();
+	void *p;
+
+	size = (size + SCRATCH_ALIGN - 1) & ~(size_t) (SCRATCH_ALIGN - 1);
+	if (scratch == NULL)
+		return malloc(size);
+
+	if (scratch->used + size <= scratch->size) {
+		p = scratch->base + scratch->used;
+		scratch->used += size;
+	} else {
+		if ((p = malloc(size)) == NULL)
+			return NULL;
+		scratch->misses++;
+	}
+	scratch->live += size;
+	if (scratch->live > scratch->highwater)
+		scratch->highwater = scratch->live;
+	return p;
+}
+
+/*!
+\brief Releases scratch memory; must be called in reverse order of allocation.
+
+\param p The memory returned by _gfxScratchAlloc().
+\param size The size that was passed to _gfxScratchAlloc().
+*/
+static void _gfxScratchFree(void *p, size_t size)
+{
+	tGfxScratch *scratch = _gfxScratchGet();
+
+	if (scratch == NULL) {
+		free(p);
+		return;
+	}
+
+	size = (size + SCRATCH_ALIGN - 1) & ~(size_t) (SCRATCH_ALIGN - 1);
+	if ((char *) p >= scratch->base && (char *) p < scratch->base + scratch->size)
+		scratch->used = (char *) p - scratch->base;
+	else
+		free(p);
+	scratch->live -= size;
+
+	// Everything released: grow the block to cover the largest use so far
+	if (scratch->live == 0 && scratch->size < scratch->highwater) {
+		free(scratch->base);
+		scratch->base = (char *) malloc(scratch->highwater);
+		scratch->size = scratch->base != NULL ? scratch->highwater : 0;
+		scratch->used = 0;
+	}
+}
+
+/*!
+\brief Reports the calling thread's scratch arena usage.
+
+The AA polygon, pie, arc and bezier primitives take their temporary arrays
+from a per-thread arena that is reused across calls. The numbers are those of
+the calling thread's arena only; other threads drawing have their own.
+
+\param highwater Returns the largest number of bytes in use at once; may be NULL.
+\param capacity Returns the current size of the arena block; may be NULL.
+\param misses Returns how many allocations didn't fit and went to the heap; may be NULL.
+*/
+void gfxPrimitivesScratchStats(size_t *highwater, size_t *capacity, size_t *misses)
+{
+	tGfxScratch *scratch = _gfxScratchGet();
+
+	if (highwater != NULL)
+		*highwater = scratch != NULL ? scratch->highwater : 0;
+	if (capacity != NULL)
+		*capacity = scratch != NULL ? scratch->size : 0;
+	if (misses != NULL)
+		*misses = scratch != NULL ? scratch->misses : 0;
+}
+
+/*!
+\brief Starts a new frame of the calling thread's scratch arena; call it once per frame.
+
+Everything allocated so far must have been released. The arena is rewound
+and, if the last frame didn't fit it, grown to that frame's high-water mark,
+so the next frame starts without heap traffic. The statistics are reset, so
+the high-water mark then measures the new frame alone.
+*/
+void gfxPrimitivesScratchReset(void)
+{
+	tGfxScratch *scratch = _gfxScratchGet();
+
+	if (scratch == NULL)
+		return;
+	if (scratch->live == 0) {
+		scratch->used = 0;
+		if (scratch->size < scratch->highwater) {
+			free(scratch->base);
+			scratch->base = (char *) malloc(scratch->highwater);
+			scratch->size = scratch->base != NULL ? scratch->highwater : 0;
+		}
+	}
+	scratch->highwater = scratch->live;
+	scratch->misses = 0;
+}
+
+/*!
+\brief Frees the calling thread's scratch arena, e.g. before exiting.
+
+Threads created with SDL_CreateThread() free their arena when they exit, but
+the main thread's is only freed by this. It is created again if the thread
+draws afterwards. Nothing may be allocated from it when this is called.
+*/
+void gfxPrimitivesScratchFree(void)
+{
+	tGfxScratch *scratch = _gfxScratchGet();
+
+	if (scratch == NULL || scratch->live != 0)
+		return;
+	SDL_TLSSet(_gfxScratchTLS, NULL, NULL);
+	_gfxScratchDestroy(scratch);
+}
+
 static int _gfxPrimitivesCompareFloat2(const void *a, const void *b)
 {
 	float diff = *(float *)(a + sizeof(float)) - *(float *)(b + sizeof(float)) ;
@@ -4392,6 +4690,7 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 	int i, j, xi, yi, result ;
 	double x1, x2, y0, y1, y2, minx, maxx, prec ;
 	float *list, *strip ;
+	size_t striplen ;
 
 	if (n < 3)
 		return -1 ;
@@ -4415,7 +4714,7 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 	prec = floor (pow(2,19) / prec) ;
 
 	// Allocate main array, this determines the maximum polygon size and complexity:
-	list = (float *) malloc (POLYSIZE * sizeof(float)) ;
+	list = (float *) _gfxScratchAlloc (POLYSIZE * sizeof(float)) ;
 	if (list == NULL)
 		return -2 ;
 
@@ -4428,7 +4727,7 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 	    {
 		if (yi > POLYSIZE - 4)
 		    {
-			free (list) ;
+			_gfxScratchFree (list, POLYSIZE * sizeof(float)) ;
 			return -2 ;
 		    }
 		y2 = floor(vy[i % n] * prec) / prec ;
@@ -4489,7 +4788,7 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 				break ;
 			if (yi > POLYSIZE - 4)
 			    {
-				free (list) ;
+				_gfxScratchFree (list, POLYSIZE * sizeof(float)) ;
 				return -2 ;
 			    }
 			if (y > y1)
@@ -4511,7 +4810,7 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 			x = x1 + y0 * (y - y1) ;
 			if (yi > POLYSIZE - 2)
 			    {
-				free (list) ;
+				_gfxScratchFree (list, POLYSIZE * sizeof(float)) ;
 				return -2 ;
 			    }
 			list[yi++] = x ;
@@ -4524,13 +4823,14 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 	qsort (list, yi / 2, sizeof(float) * 2, _gfxPrimitivesCompareFloat2) ;
 
 	// Plot lines:
-	strip = (float *) malloc ((maxx - minx + 2) * sizeof(float)) ;
+	striplen = (maxx - minx + 2) * sizeof(float) ;
+	strip = (float *) _gfxScratchAlloc (striplen) ;
 	if (strip == NULL)
 	    {
-		free (list) ;
+		_gfxScratchFree (list, POLYSIZE * sizeof(float)) ;
 		return -1 ;
 	    }
-	memset (strip, 0, (maxx - minx + 2) * sizeof(float)) ;
+	memset (strip, 0, striplen) ;
 	n = yi ;
 	yi = list[1] ;
 	j = 0 ;
@@ -4585,15 +4885,15 @@ int aaFilledPolygonRGBA(SDL_Renderer * renderer, const double * vx, const double
 					    }
 				    }
 			    }
-			memset (strip, 0, (maxx - minx + 2) * sizeof(float)) ;
+			memset (strip, 0, striplen) ;
 			yi++ ;
 
 		    }
 	    }
 
-	// Free arrays:
-	free (list) ;
-	free (strip) ;
+	// Free arrays (in reverse order of allocation):
+	_gfxScratchFree (strip, striplen) ;
+	_gfxScratchFree (list, POLYSIZE * sizeof(float)) ;
 	return result ;
 }
 
@@ -4646,7 +4946,7 @@ int aaFilledPieRGBA(SDL_Renderer * renderer, float cx, float cy, float rx, float
 		nverts = 180 ;
 
 	// Allocate combined vertex array 
-	vx = vy = (double *) malloc(2 * sizeof(double) * (nverts + 1));
+	vx = vy = (double *) _gfxScratchAlloc(2 * sizeof(double) * (nverts + 1));
 	if (vx == NULL)
 		return (-1);
 
@@ -4668,7 +4968,7 @@ int aaFilledPieRGBA(SDL_Renderer * renderer, float cx, float cy, float rx, float
 	result = aaFilledPolygonRGBA(renderer, vx, vy, nverts + 1 - (chord != 0), r, g, b, a);
 
 	// Free combined vertex array
-	free(vx);
+	_gfxScratchFree(vx, 2 * sizeof(double) * (nverts + 1));
 
 	return (result);
 }
@@ -4722,7 +5022,7 @@ int aaArcRGBA(SDL_Renderer * renderer, float cx, float cy, float rx, float ry,
 		nverts = 360 ;
 
 	// Allocate combined vertex array 
-	vx = vy = (double *) malloc(2 * sizeof(double) * nverts);
+	vx = vy = (double *) _gfxScratchAlloc(2 * sizeof(double) * nverts);
 	if (vx == NULL)
 		return (-1);
 
@@ -4743,7 +5043,7 @@ int aaArcRGBA(SDL_Renderer * renderer, float cx, float cy, float rx, float ry,
 	result = aaFilledPolygonRGBA(renderer, vx, vy, nverts, r, g, b, a);
 
 	// Free combined vertex array
-	free(vx);
+	_gfxScratchFree(vx, 2 * sizeof(double) * nverts);
 
 	return (result);
 }
@@ -4774,9 +5074,10 @@ int aaArcColor(SDL_Renderer * renderer, float cx, float cy, float rx, float ry,
 int aaBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n, int s, float thick, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
 	int i, nverts, result;
-	double d, t, stepsize;
+	double d;
 	double x1, y1, x2, y2, dx = 0.0, dy = 0.0 ;
 	double *vx, *vy ;
+	tGfxBezierIter itx, ity ;
 
 	// Sanity check 
 	if ((n < 3) || (s < 2))
@@ -4784,21 +5085,20 @@ int aaBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n, int s, fl
 
 	// Create combined vertex array:
 	nverts = n * s * 2 + 2 ;
-	vx = (double *) malloc (nverts * 2 * sizeof(double)) ;
+	vx = (double *) _gfxScratchAlloc (nverts * 2 * sizeof(double)) ;
 	if (vx == NULL)
 		return -1 ;
 	vy = vx + nverts ;
 
 	// Draw Bezier
-	t = 0.0 ;
-	stepsize = 1.0 / (double)s ;
-	x1 = _evaluateBezier(x, n, t) ;
-	y1 = _evaluateBezier(y, n, t) ;
+	_bezierIterInit(&itx, x, n, n*s) ;
+	_bezierIterInit(&ity, y, n, n*s) ;
+	x1 = _bezierIterNext(&itx) ;
+	y1 = _bezierIterNext(&ity) ;
 	for (i = 0; i < n*s; i++)
 	    {
-		t += stepsize ;
-		x2 = _evaluateBezier(x, n, t) ;
-		y2 = _evaluateBezier(y, n, t) ;
+		x2 = _bezierIterNext(&itx) ;
+		y2 = _bezierIterNext(&ity) ;
 
 		dx = x2 - x1 ;
 		dy = y2 - y1 ;
@@ -4822,7 +5122,7 @@ int aaBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n, int s, fl
 
 	result = aaFilledPolygonRGBA(renderer, vx, vy, nverts, r, g, b, a);
 
-	free (vx) ;
+	_gfxScratchFree (vx, nverts * 2 * sizeof(double)) ;
 	return (result);
 }
 
@@ -4833,6 +5133,75 @@ int aaBezierColor(SDL_Renderer * renderer, double *x, double *y, int n, int s, f
 	return aaBezierRGBA(renderer, x, y, n, s, thick, c[0], c[1], c[2], c[3]);
 }
 
+/*!
+\brief Draw an anti-aliased thick polyline with alpha blending.
+
+The outline is built like that of aaBezierRGBA(), so a curve flattened with
+bezierFlatten() can be drawn from its cached polyline.
+
+\param renderer The renderer to draw on.
+\param x Vertex array containing X coordinates of the points of the polyline.
+\param y Vertex array containing Y coordinates of the points of the polyline.
+\param n Number of points in the vertex array. Minimum number is 2.
+\param thick Thickness of line in pixels.
+\param r The red value of the polyline to draw. 
+\param g The green value of the polyline to draw. 
+\param b The blue value of the polyline to draw. 
+\param a The alpha value of the polyline to draw.
+
+\returns Returns 0 on success, -1 on failure.
+*/
+int aaPolylineRGBA(SDL_Renderer * renderer, const double *x, const double *y, int n, float thick, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+	int i, nverts, result;
+	double d, len;
+	double dx = 0.0, dy = 0.0 ;
+	double *vx, *vy ;
+
+	// Sanity check 
+	if (n < 2)
+		return -1 ;
+
+	// Create combined vertex array:
+	nverts = n * 2 ;
+	vx = (double *) _gfxScratchAlloc (nverts * 2 * sizeof(double)) ;
+	if (vx == NULL)
+		return -1 ;
+	vy = vx + nverts ;
+
+	for (i = 0; i < n; i++)
+	    {
+		// Each point is offset along the normal of the segment leaving it
+		// (the last one along that of the segment reaching it); repeated
+		// points keep the previous normal
+		if (i < n - 1) {
+			len = sqrt((x[i+1] - x[i]) * (x[i+1] - x[i]) + (y[i+1] - y[i]) * (y[i+1] - y[i])) ;
+			if (len > 0.0) {
+				d = thick * 0.5L / len ;
+				dx = (x[i+1] - x[i]) * d ;
+				dy = (y[i+1] - y[i]) * d ;
+			}
+		}
+
+		vx[i] = x[i] + dy ;
+		vy[i] = y[i] - dx ;
+		vx[nverts-1-i] = x[i] - dy ;
+		vy[nverts-1-i] = y[i] + dx ;
+	    }
+
+	result = aaFilledPolygonRGBA(renderer, vx, vy, nverts, r, g, b, a);
+
+	_gfxScratchFree (vx, nverts * 2 * sizeof(double)) ;
+	return (result);
+}
+
+// returns Returns 0 on success, -1 on failure.
+int aaPolylineColor(SDL_Renderer * renderer, const double *x, const double *y, int n, float thick, Uint32 color)
+{
+	Uint8 *c = (Uint8 *)&color; 
+	return aaPolylineRGBA(renderer, x, y, n, thick, c[0], c[1], c[2], c[3]);
+}
+
 /*!
 \brief Fill an anti-aliased region bounded by cubic Bezier curves, with alpha blending.
 
@@ -4851,9 +5220,9 @@ int aaBezierColor(SDL_Renderer * renderer, double *x, double *y, int n, int s, f
 int aaFilledPolyBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n, int s, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
 	int i, j, nbeziers, nverts, result;
-	double t, stepsize;
 	double x1, y1, x2, y2 ;
 	double *vx, *vy ;
+	tGfxBezierIter itx, ity ;
 
 	// Sanity check 
 	if ((n < 7) || (s < 2))
@@ -4862,23 +5231,22 @@ int aaFilledPolyBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n,
 	// Create combined vertex array:
 	nbeziers = (n - 1) / 3 ;
 	nverts = nbeziers * 4 * s + 1 ;
-	vx = (double *) malloc (nverts * 2 * sizeof(double)) ;
+	vx = (double *) _gfxScratchAlloc (nverts * 2 * sizeof(double)) ;
 	if (vx == NULL)
 		return -1 ;
 	vy = vx + nverts ;
 
 	// Draw Beziers
-	stepsize = 1.0 / (double)s ;
 	for (j = 0; j < nbeziers; j++)
 	    {
-		t = 0.0 ;
-		x1 = _evaluateBezier(x + j * 3, 4, t) ;
-		y1 = _evaluateBezier(y + j * 3, 4, t) ;
+		_bezierIterInit(&itx, x + j * 3, 4, 4*s) ;
+		_bezierIterInit(&ity, y + j * 3, 4, 4*s) ;
+		x1 = _bezierIterNext(&itx) ;
+		y1 = _bezierIterNext(&ity) ;
 		for (i = 0; i < 4*s; i++)
 		    {
-			t += stepsize ;
-			x2 = _evaluateBezier(x + j * 3, 4, t) ;
-			y2 = _evaluateBezier(y + j * 3, 4, t) ;
+			x2 = _bezierIterNext(&itx) ;
+			y2 = _bezierIterNext(&ity) ;
 
 			vx[i + j * s * 4] = x1 ;
 			vy[i + j * s * 4] = y1 ;
@@ -4893,7 +5261,7 @@ int aaFilledPolyBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n,
 
 	result = aaFilledPolygonRGBA(renderer, vx, vy, nverts, r, g, b, a);
 
-	free (vx) ;
+	_gfxScratchFree (vx, nverts * 2 * sizeof(double)) ;
 	return (result);
 }
 
@@ -4903,3 +5271,128 @@ int aaFilledPolyBezierColor(SDL_Renderer * renderer, double *x, double *y, int n
 	Uint8 *c = (Uint8 *)&color; 
 	return aaFilledPolyBezierRGBA(renderer, x, y, n, s, c[0], c[1], c[2], c[3]);
 }
+
+/* ---- Bezier flattening */
+
+/*!
+\brief Maximum subdivision depth of bezierFlatten(), i.e. at most 2^16 segments per curve.
+*/
+#define BEZIER_MAX_DEPTH 16
+
+/*!
+\brief Internal function testing whether a bezier control polygon is within 'tolerance' of its chord.
+
+Since the curve lies inside the hull of its control points, the curve is
+then within 'tolerance' of the chord too.
+*/
+static int _bezierIsFlat(const double *x, const double *y, int n, double tolerance)
+{
+	double dx, dy, len2, px, py, u, dist2;
+	int i;
+
+	dx = x[n - 1] - x[0];
+	dy = y[n - 1] - y[0];
+	len2 = dx * dx + dy * dy;
+	for (i = 1; i < n - 1; i++) {
+		px = x[i] - x[0];
+		py = y[i] - y[0];
+		u = (len2 > 0.0) ? (px * dx + py * dy) / len2 : 0.0;
+		if (u < 0.0) u = 0.0;
+		if (u > 1.0) u = 1.0;
+		px -= u * dx;
+		py -= u * dy;
+		dist2 = px * px + py * py;
+		if (dist2 > tolerance * tolerance) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*!
+\brief Flattens a bezier curve into a polyline, adaptively to its curvature.
+
+The curve is split in halves (de Casteljau) until each piece's control
+polygon lies within 'tolerance' of its chord, so straight stretches give few
+points and tight bends many. Flatten a curve once and redraw or collide
+against the polyline instead of re-evaluating the curve every frame.
+
+If more than 'maxpoints' points are needed only the first 'maxpoints' are
+stored; call with maxpoints 0 to query the size.
+
+\param x Array of n control point X coordinates.
+\param y Array of n control point Y coordinates.
+\param n Number of control points. Minimum number is 2.
+\param tolerance Maximum distance in pixels between the curve and the polyline.
+\param px Array receiving the X coordinates of the polyline; may be NULL if maxpoints is 0.
+\param py Array receiving the Y coordinates of the polyline; may be NULL if maxpoints is 0.
+\param maxpoints Size of the px and py arrays.
+
+\returns The number of polyline points, including both end points, or -1 on failure.
+*/
+int bezierFlatten(const double *x, const double *y, int n, double tolerance, double *px, double *py, int maxpoints)
+{
+	int depth[BEZIER_MAX_DEPTH + 2];
+	double *stack, *cx, *cy, *lx, *ly, *wx, *wy;
+	size_t size;
+	int top, count, i, r, d;
+
+	if ((x == NULL) || (y == NULL) || (n < 2) || (tolerance <= 0.0))
+		return -1;
+
+	/* Stack of control polygons, each n X values followed by n Y values, plus a work polygon */
+	size = (BEZIER_MAX_DEPTH + 3) * 2 * n * sizeof(double);
+	if ((stack = (double *) _gfxScratchAlloc(size)) == NULL)
+		return -1;
+	wx = stack + (BEZIER_MAX_DEPTH + 2) * 2 * n;
+	wy = wx + n;
+
+	count = 0;
+	if (maxpoints > 0) {
+		px[0] = x[0];
+		py[0] = y[0];
+	}
+	count++;
+
+	memcpy(stack, x, n * sizeof(double));
+	memcpy(stack + n, y, n * sizeof(double));
+	depth[0] = 0;
+	top = 1;
+	d = n - 1;
+	while (top > 0) {
+		cx = stack + (top - 1) * 2 * n;
+		cy = cx + n;
+		if ((depth[top - 1] >= BEZIER_MAX_DEPTH) || _bezierIsFlat(cx, cy, n, tolerance)) {
+			if (count < maxpoints) {
+				px[count] = cx[d];
+				py[count] = cy[d];
+			}
+			count++;
+			top--;
+			continue;
+		}
+
+		/* Split: the right half replaces the curve, the left half is pushed on top */
+		memcpy(wx, cx, n * sizeof(double));
+		memcpy(wy, cy, n * sizeof(double));
+		lx = cx + 2 * n;
+		ly = lx + n;
+		lx[0] = wx[0];
+		ly[0] = wy[0];
+		for (r = 1; r <= d; r++) {
+			for (i = 0; i <= d - r; i++) {
+				wx[i] = (wx[i] + wx[i + 1]) * 0.5;
+				wy[i] = (wy[i] + wy[i + 1]) * 0.5;
+			}
+			lx[r] = wx[0];
+			ly[r] = wy[0];
+			cx[d - r] = wx[d - r];
+			cy[d - r] = wy[d - r];
+		}
+		depth[top] = ++depth[top - 1];
+		top++;
+	}
+
+	_gfxScratchFree(stack, size);
+	return count;
+}
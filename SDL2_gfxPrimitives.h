@@ -217,9 +217,27 @@ extern "C" {
 	SDL2_GFXPRIMITIVES_SCOPE int filledPolygonRGBA(SDL_Renderer * renderer, const Sint16 * vx,
 		const Sint16 * vy, int n, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
 
+	/* Polygon contexts (one per thread filling polygons concurrently) */
+
+	typedef struct PolygonContext PolygonContext;
+
+	SDL2_GFXPRIMITIVES_SCOPE PolygonContext *polygonContextCreate(void);
+	SDL2_GFXPRIMITIVES_SCOPE void polygonContextDestroy(PolygonContext *ctx);
+	SDL2_GFXPRIMITIVES_SCOPE int filledPolygonRGBACtx(SDL_Renderer * renderer, PolygonContext *ctx, const Sint16 * vx,
+		const Sint16 * vy, int n, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+
 	/* Textured Polygon */
 
 	SDL2_GFXPRIMITIVES_SCOPE int texturedPolygon(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n, SDL_Surface * texture,int texture_dx,int texture_dy);
+	SDL2_GFXPRIMITIVES_SCOPE int texturedPolygonCtx(SDL_Renderer * renderer, PolygonContext *ctx, const Sint16 * vx, const Sint16 * vy, int n,
+		SDL_Surface * texture, int texture_dx, int texture_dy);
+
+	/* Deprecated: polyInts and polyAllocated are ignored, use the functions above */
+
+	SDL2_GFXPRIMITIVES_SCOPE int filledPolygonRGBAMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n,
+		Uint8 r, Uint8 g, Uint8 b, Uint8 a, int **polyInts, int *polyAllocated);
+	SDL2_GFXPRIMITIVES_SCOPE int texturedPolygonMT(SDL_Renderer * renderer, const Sint16 * vx, const Sint16 * vy, int n,
+		SDL_Surface * texture, int texture_dx, int texture_dy, int **polyInts, int *polyAllocated);
 
 	/* Bezier */
 
@@ -258,8 +276,17 @@ extern "C" {
 		float start, float end, float thick, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
 	SDL2_GFXPRIMITIVES_SCOPE int aaBezierColor(SDL_Renderer * renderer, double *x, double *y, int n, int s, float thick, Uint32 color);
 	SDL2_GFXPRIMITIVES_SCOPE int aaBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n, int s, float thick, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+	SDL2_GFXPRIMITIVES_SCOPE int aaPolylineColor(SDL_Renderer * renderer, const double *x, const double *y, int n, float thick, Uint32 color);
+	SDL2_GFXPRIMITIVES_SCOPE int aaPolylineRGBA(SDL_Renderer * renderer, const double *x, const double *y, int n, float thick, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
 	SDL2_GFXPRIMITIVES_SCOPE int aaFilledPolyBezierColor(SDL_Renderer * renderer, double *x, double *y, int n, int s, Uint32 color);
 	SDL2_GFXPRIMITIVES_SCOPE int aaFilledPolyBezierRGBA(SDL_Renderer * renderer, double *x, double *y, int n, int s, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+	SDL2_GFXPRIMITIVES_SCOPE int bezierFlatten(const double *x, const double *y, int n, double tolerance, double *px, double *py, int maxpoints);
+
+	/* Scratch arena used by the AA primitives (per thread; each call acts on the calling thread's arena) */
+
+	SDL2_GFXPRIMITIVES_SCOPE void gfxPrimitivesScratchStats(size_t *highwater, size_t *capacity, size_t *misses);
+	SDL2_GFXPRIMITIVES_SCOPE void gfxPrimitivesScratchReset(void);
+	SDL2_GFXPRIMITIVES_SCOPE void gfxPrimitivesScratchFree(void);
 
 	/* Ends C function definitions when using C++ */
 #ifdef __cplusplus
@@ -85,6 +85,11 @@ typedef struct tColorY {
 */
 #define MAX(a,b)    (((a) > (b)) ? (a) : (b))
 
+/*! 
+\brief Returns minimum of two numbers a and b.
+*/
+#define MIN(a,b)    (((a) < (b)) ? (a) : (b))
+
 /*! 
 \brief Number of guard rows added to destination surfaces.
 
@@ -112,24 +117,310 @@ Uint32 _colorkey(SDL_Surface *src)
 	return key;
 }
 
+/* ---- Worker pool */
 
-/*! 
-\brief Internal 32 bit integer-factor averaging Shrinker.
+/*!
+\brief Upper limit of worker threads used by the 32 bit kernels.
+*/
+#define ROTOZOOM_MAX_THREADS 16
 
-Shrinks 32 bit RGBA/ABGR 'src' surface to 'dst' surface.
-Averages color and alpha values values of src pixels to calculate dst pixels.
-Assumes src and dst surfaces are of 32 bit depth.
-Assumes dst surface was allocated with the correct dimensions.
+/*!
+\brief Destination surfaces with fewer pixels than this are processed serially.
+*/
+#define ROTOZOOM_PARALLEL_MIN (128*128)
 
-\param src The surface to shrink (input).
-\param dst The shrunken surface (output).
-\param factorx The horizontal shrinking ratio.
-\param factory The vertical shrinking ratio.
+/*!
+\brief Number of row bands handed out per thread, to balance uneven rows.
+*/
+#define ROTOZOOM_BANDS_PER_THREAD 4
 
-\return 0 for success or -1 for error.
+/*!
+\brief Processes destination rows y0 (inclusive) to y1 (exclusive) of a job.
 */
-int _shrinkSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int factorx, int factory)
+typedef void (*tRowFunc)(void *job, int y0, int y1);
+
+/*!
+\brief Shared pool of worker threads for the row-parallel kernels.
+
+Bands are handed out under the lock, and a new job is only published once
+every band of the previous one has finished, so workers can never mix up
+bands of two different jobs. The lock is created once under _poolOnce. The
+workers are only started, stopped or resized by the thread which holds the
+pool busy, so no job is running meanwhile.
+*/
+static struct {
+	SDL_mutex *lock;
+	SDL_cond *work;
+	SDL_cond *done;
+	SDL_Thread *threads[ROTOZOOM_MAX_THREADS];
+	int nthreads;
+	int target;
+	int quit;
+	int busy;
+	unsigned int generation;
+	tRowFunc func;
+	void *job;
+	int rows, bands, next, pending;
+} _pool;
+
+/*!
+\brief Guards the one-time creation of the pool lock.
+*/
+static SDL_SpinLock _poolOnce = 0;
+
+/*!
+\brief Requested number of threads, 0 meaning one per CPU.
+*/
+static SDL_atomic_t _rotozoomThreads;
+
+/*!
+\brief Runs bands of the current job until none are left. Called with the pool lock held.
+*/
+static void _poolRun(unsigned int generation)
+{
+	int b, y0, y1;
+
+	while (_pool.generation == generation && _pool.next < _pool.bands) {
+		b = _pool.next++;
+		y0 = (int) ((Sint64) _pool.rows * b / _pool.bands);
+		y1 = (int) ((Sint64) _pool.rows * (b + 1) / _pool.bands);
+		SDL_UnlockMutex(_pool.lock);
+		_pool.func(_pool.job, y0, y1);
+		SDL_LockMutex(_pool.lock);
+		if (--_pool.pending == 0) {
+			SDL_CondSignal(_pool.done);
+		}
+	}
+}
+
+static int _poolWorker(void *data)
 {
+	unsigned int generation = 0;
+
+	SDL_LockMutex(_pool.lock);
+	for (;;) {
+		while (!_pool.quit && _pool.generation == generation) {
+			SDL_CondWait(_pool.work, _pool.lock);
+		}
+		if (_pool.quit) {
+			break;
+		}
+		generation = _pool.generation;
+		_poolRun(generation);
+	}
+	SDL_UnlockMutex(_pool.lock);
+
+	return 0;
+}
+
+/*!
+\brief Creates the pool lock and conditions on first use, from any thread.
+
+\returns Non-zero if the pool can be used.
+*/
+static int _poolInit()
+{
+	int ok;
+
+	SDL_AtomicLock(&_poolOnce);
+	if (_pool.lock == NULL) {
+		_pool.work = SDL_CreateCond();
+		_pool.done = SDL_CreateCond();
+		if (_pool.work != NULL && _pool.done != NULL) {
+			_pool.lock = SDL_CreateMutex();
+		}
+		if (_pool.lock == NULL) {
+			SDL_DestroyCond(_pool.work);
+			SDL_DestroyCond(_pool.done);
+			_pool.work = _pool.done = NULL;
+		}
+	}
+	ok = _pool.lock != NULL;
+	SDL_AtomicUnlock(&_poolOnce);
+
+	return ok;
+}
+
+/*!
+\brief Claims the pool for one job or a resize.
+
+\returns Non-zero if it was idle and is now held busy by the caller.
+*/
+static int _poolClaim()
+{
+	int claimed = 0;
+
+	SDL_LockMutex(_pool.lock);
+	if (!_pool.busy) {
+		_pool.busy = 1;
+		claimed = 1;
+	}
+	SDL_UnlockMutex(_pool.lock);
+
+	return claimed;
+}
+
+/*!
+\brief Releases the pool claimed with _poolClaim().
+*/
+static void _poolRelease()
+{
+	SDL_LockMutex(_pool.lock);
+	_pool.busy = 0;
+	SDL_UnlockMutex(_pool.lock);
+}
+
+/*!
+\brief Stops and joins all worker threads. The caller holds the pool busy.
+*/
+static void _poolStop()
+{
+	int i;
+
+	SDL_LockMutex(_pool.lock);
+	_pool.quit = 1;
+	SDL_CondBroadcast(_pool.work);
+	SDL_UnlockMutex(_pool.lock);
+	for (i = 0; i < _pool.nthreads; i++) {
+		SDL_WaitThread(_pool.threads[i], NULL);
+	}
+	_pool.nthreads = 0;
+	_pool.quit = 0;
+}
+
+/*!
+\brief Resizes the pool to nthreads workers. The caller holds the pool busy.
+
+If fewer workers can be created, the pool is kept short rather than being
+restarted on every call.
+*/
+static void _poolResize(int nthreads)
+{
+	if (_pool.target == nthreads) {
+		return;
+	}
+	_poolStop();
+	while (_pool.nthreads < nthreads) {
+		_pool.threads[_pool.nthreads] = SDL_CreateThread(_poolWorker, "rotozoom", NULL);
+		if (_pool.threads[_pool.nthreads] == NULL) {
+			break;
+		}
+		_pool.nthreads++;
+	}
+	_pool.target = nthreads;
+}
+
+/*!
+\brief Runs a row function over all rows of a destination, in parallel bands when worthwhile.
+
+Falls back to a serial call for small destinations, when only one thread is
+configured, when threads are unavailable, or when the pool is already busy
+with a job from another thread.
+
+\param func The row function.
+\param job The job passed to the row function.
+\param rows The number of destination rows.
+\param pixels The number of destination pixels, used to decide if threading pays off.
+*/
+static void _parallelRows(tRowFunc func, void *job, int rows, int pixels)
+{
+	int nthreads = rotozoomGetThreads();
+
+	if (nthreads <= 1 || pixels < ROTOZOOM_PARALLEL_MIN || rows < 2) {
+		func(job, 0, rows);
+		return;
+	}
+
+	if (!_poolInit() || !_poolClaim()) {
+		func(job, 0, rows);
+		return;
+	}
+	_poolResize(nthreads - 1);
+	if (_pool.nthreads == 0) {
+		_poolRelease();
+		func(job, 0, rows);
+		return;
+	}
+
+	SDL_LockMutex(_pool.lock);
+	_pool.func = func;
+	_pool.job = job;
+	_pool.rows = rows;
+	_pool.bands = MIN(rows, (_pool.nthreads + 1) * ROTOZOOM_BANDS_PER_THREAD);
+	_pool.next = 0;
+	_pool.pending = _pool.bands;
+	_pool.generation++;
+	SDL_CondBroadcast(_pool.work);
+
+	/* The calling thread takes bands too */
+	_poolRun(_pool.generation);
+	while (_pool.pending > 0) {
+		SDL_CondWait(_pool.done, _pool.lock);
+	}
+	_pool.busy = 0;
+	SDL_UnlockMutex(_pool.lock);
+}
+
+/*!
+\brief Sets the number of threads used by the 32 bit zoom, rotozoom and shrink kernels.
+
+\param nthreads Number of threads including the calling thread; 1 disables threading,
+0 uses one thread per CPU.
+*/
+void rotozoomSetThreads(int nthreads)
+{
+	if (nthreads < 0) {
+		nthreads = 0;
+	}
+	if (nthreads > ROTOZOOM_MAX_THREADS + 1) {
+		nthreads = ROTOZOOM_MAX_THREADS + 1;
+	}
+	SDL_AtomicSet(&_rotozoomThreads, nthreads);
+
+	/* Without threading the workers aren't needed. If a job is running they
+	are stopped by the next call instead */
+	if (nthreads == 1 && _poolInit() && _poolClaim()) {
+		_poolResize(0);
+		_poolRelease();
+	}
+}
+
+/*!
+\brief Returns the number of threads used by the 32 bit kernels.
+
+\return The configured thread count, or the CPU count if it was set to 0.
+*/
+int rotozoomGetThreads()
+{
+	int n = SDL_AtomicGet(&_rotozoomThreads);
+
+	if (n == 0) {
+		n = MIN(SDL_GetCPUCount(), ROTOZOOM_MAX_THREADS + 1);
+	}
+	return n;
+}
+
+
+/*!
+\brief Job for the row-parallel 32 bit shrinker.
+*/
+typedef struct tShrinkJob {
+	SDL_Surface *src;
+	SDL_Surface *dst;
+	int factorx;
+	int factory;
+} tShrinkJob;
+
+/*!
+\brief Shrinks destination rows y0 to y1 of a tShrinkJob.
+*/
+static void _shrinkRowsRGBA(void *data, int y0, int y1)
+{
+	tShrinkJob *job = (tShrinkJob *) data;
+	SDL_Surface *src = job->src;
+	SDL_Surface *dst = job->dst;
+	int factorx = job->factorx;
+	int factory = job->factory;
 	int x, y, dx, dy, dgap, ra, ga, ba, aa;
 	int n_average;
 	tColorRGBA *sp, *osp, *oosp;
@@ -145,12 +436,12 @@ int _shrinkSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int factorx, int fa
 	/*
 	* Scan destination
 	*/
-	sp = (tColorRGBA *) src->pixels;
+	sp = (tColorRGBA *) ((Uint8 *) src->pixels + src->pitch*factory*y0);
 	
-	dp = (tColorRGBA *) dst->pixels;
+	dp = (tColorRGBA *) ((Uint8 *) dst->pixels + dst->pitch*y0);
 	dgap = dst->pitch - dst->w * 4;
 
-	for (y = 0; y < dst->h; y++) {
+	for (y = y0; y < y1; y++) {
 
 		osp=sp;
 		for (x = 0; x < dst->w; x++) {
@@ -197,6 +488,246 @@ int _shrinkSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int factorx, int fa
 		dp = (tColorRGBA *) ((Uint8 *) dp + dgap);
 	} 
 	/* dst y loop */
+}
+
+/* ---- Bilinear interpolation kernels */
+
+/*!
+\brief Number of destination pixels gathered before they are interpolated in one go.
+*/
+#define BILINEAR_CHUNK 64
+
+/*!
+\brief Corner colors and 16.16 fractions of a run of destination pixels to interpolate.
+*/
+typedef struct tBilinearChunk {
+	tColorRGBA c00[BILINEAR_CHUNK];
+	tColorRGBA c01[BILINEAR_CHUNK];
+	tColorRGBA c10[BILINEAR_CHUNK];
+	tColorRGBA c11[BILINEAR_CHUNK];
+	Uint16 ex[BILINEAR_CHUNK];
+	Uint16 ey[BILINEAR_CHUNK];
+} tBilinearChunk;
+
+/*!
+\brief Interpolates pixels i to n of a chunk with the reference fixed-point arithmetic.
+
+All vector kernels must produce exactly the same bytes as this one.
+*/
+static void _bilinearScalar(const tBilinearChunk *ch, tColorRGBA *dp, int i, int n)
+{
+	const tColorRGBA *c00, *c01, *c10, *c11;
+	int ex, ey, t1, t2;
+
+	for (; i < n; i++) {
+		c00 = &ch->c00[i];
+		c01 = &ch->c01[i];
+		c10 = &ch->c10[i];
+		c11 = &ch->c11[i];
+		ex = ch->ex[i];
+		ey = ch->ey[i];
+		t1 = ((((c01->r - c00->r) * ex) >> 16) + c00->r) & 0xff;
+		t2 = ((((c11->r - c10->r) * ex) >> 16) + c10->r) & 0xff;
+		dp[i].r = (((t2 - t1) * ey) >> 16) + t1;
+		t1 = ((((c01->g - c00->g) * ex) >> 16) + c00->g) & 0xff;
+		t2 = ((((c11->g - c10->g) * ex) >> 16) + c10->g) & 0xff;
+		dp[i].g = (((t2 - t1) * ey) >> 16) + t1;
+		t1 = ((((c01->b - c00->b) * ex) >> 16) + c00->b) & 0xff;
+		t2 = ((((c11->b - c10->b) * ex) >> 16) + c10->b) & 0xff;
+		dp[i].b = (((t2 - t1) * ey) >> 16) + t1;
+		t1 = ((((c01->a - c00->a) * ex) >> 16) + c00->a) & 0xff;
+		t2 = ((((c11->a - c10->a) * ex) >> 16) + c10->a) & 0xff;
+		dp[i].a = (((t2 - t1) * ey) >> 16) + t1;
+	}
+}
+
+static void _bilinearPortable(const tBilinearChunk *ch, tColorRGBA *dp, int n)
+{
+	_bilinearScalar(ch, dp, 0, n);
+}
+
+/*
+The x86 kernels work on 16 bit lanes. (d * w) >> 16 for a signed 9 bit
+difference d and an unsigned 16 bit weight w is the high half of the
+unsigned product of d's two's complement and w, minus w when d is
+negative, which is exact.
+*/
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ROTOZOOM_SSE2
+
+static __m128i _mulShr16SSE2(__m128i d, __m128i w)
+{
+	__m128i hi = _mm_mulhi_epu16(d, w);
+	return _mm_sub_epi16(hi, _mm_and_si128(w, _mm_srai_epi16(d, 15)));
+}
+
+/*!
+\brief Interpolates two pixels held as eight 16 bit channel lanes.
+*/
+static __m128i _lerpSSE2(__m128i c00, __m128i c01, __m128i c10, __m128i c11, __m128i ex, __m128i ey)
+{
+	__m128i mask = _mm_set1_epi16(0xff);
+	__m128i t1, t2;
+
+	t1 = _mm_and_si128(_mm_add_epi16(_mulShr16SSE2(_mm_sub_epi16(c01, c00), ex), c00), mask);
+	t2 = _mm_and_si128(_mm_add_epi16(_mulShr16SSE2(_mm_sub_epi16(c11, c10), ex), c10), mask);
+	return _mm_and_si128(_mm_add_epi16(_mulShr16SSE2(_mm_sub_epi16(t2, t1), ey), t1), mask);
+}
+
+/*!
+\brief Interpolates four pixels per iteration with SSE2.
+*/
+static void _bilinearSSE2(const tBilinearChunk *ch, tColorRGBA *dp, int n)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i c00, c01, c10, c11, ex, ey, exlo, exhi, eylo, eyhi, lo, hi;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		c00 = _mm_loadu_si128((const __m128i *) &ch->c00[i]);
+		c01 = _mm_loadu_si128((const __m128i *) &ch->c01[i]);
+		c10 = _mm_loadu_si128((const __m128i *) &ch->c10[i]);
+		c11 = _mm_loadu_si128((const __m128i *) &ch->c11[i]);
+
+		/* Spread each pixel's weights over its four channel lanes */
+		ex = _mm_loadl_epi64((const __m128i *) &ch->ex[i]);
+		ex = _mm_unpacklo_epi16(ex, ex);
+		exlo = _mm_unpacklo_epi32(ex, ex);
+		exhi = _mm_unpackhi_epi32(ex, ex);
+		ey = _mm_loadl_epi64((const __m128i *) &ch->ey[i]);
+		ey = _mm_unpacklo_epi16(ey, ey);
+		eylo = _mm_unpacklo_epi32(ey, ey);
+		eyhi = _mm_unpackhi_epi32(ey, ey);
+
+		lo = _lerpSSE2(_mm_unpacklo_epi8(c00, zero), _mm_unpacklo_epi8(c01, zero),
+			_mm_unpacklo_epi8(c10, zero), _mm_unpacklo_epi8(c11, zero), exlo, eylo);
+		hi = _lerpSSE2(_mm_unpackhi_epi8(c00, zero), _mm_unpackhi_epi8(c01, zero),
+			_mm_unpackhi_epi8(c10, zero), _mm_unpackhi_epi8(c11, zero), exhi, eyhi);
+		_mm_storeu_si128((__m128i *) &dp[i], _mm_packus_epi16(lo, hi));
+	}
+	_bilinearScalar(ch, dp, i, n);
+}
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ROTOZOOM_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static __m256i _mulShr16AVX2(__m256i d, __m256i w)
+{
+	__m256i hi = _mm256_mulhi_epu16(d, w);
+	return _mm256_sub_epi16(hi, _mm256_and_si256(w, _mm256_srai_epi16(d, 15)));
+}
+
+AVX2_TARGET static __m256i _lerpAVX2(__m256i c00, __m256i c01, __m256i c10, __m256i c11, __m256i ex, __m256i ey)
+{
+	__m256i mask = _mm256_set1_epi16(0xff);
+	__m256i t1, t2;
+
+	t1 = _mm256_and_si256(_mm256_add_epi16(_mulShr16AVX2(_mm256_sub_epi16(c01, c00), ex), c00), mask);
+	t2 = _mm256_and_si256(_mm256_add_epi16(_mulShr16AVX2(_mm256_sub_epi16(c11, c10), ex), c10), mask);
+	return _mm256_and_si256(_mm256_add_epi16(_mulShr16AVX2(_mm256_sub_epi16(t2, t1), ey), t1), mask);
+}
+
+/*!
+\brief Interpolates eight pixels per iteration with AVX2.
+
+The byte unpacks work within 128 bit lanes, so the low half holds pixels
+0, 1, 4 and 5 and the high half pixels 2, 3, 6 and 7; the weights are
+spread in the same order and the final pack restores pixel order.
+*/
+AVX2_TARGET static void _bilinearAVX2(const tBilinearChunk *ch, tColorRGBA *dp, int n)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i c00, c01, c10, c11, ex, ey, exlo, exhi, eylo, eyhi, lo, hi;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		c00 = _mm256_loadu_si256((const __m256i *) &ch->c00[i]);
+		c01 = _mm256_loadu_si256((const __m256i *) &ch->c01[i]);
+		c10 = _mm256_loadu_si256((const __m256i *) &ch->c10[i]);
+		c11 = _mm256_loadu_si256((const __m256i *) &ch->c11[i]);
+
+		ex = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) &ch->ex[i]));
+		ex = _mm256_or_si256(ex, _mm256_slli_epi32(ex, 16));
+		exlo = _mm256_unpacklo_epi32(ex, ex);
+		exhi = _mm256_unpackhi_epi32(ex, ex);
+		ey = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) &ch->ey[i]));
+		ey = _mm256_or_si256(ey, _mm256_slli_epi32(ey, 16));
+		eylo = _mm256_unpacklo_epi32(ey, ey);
+		eyhi = _mm256_unpackhi_epi32(ey, ey);
+
+		lo = _lerpAVX2(_mm256_unpacklo_epi8(c00, zero), _mm256_unpacklo_epi8(c01, zero),
+			_mm256_unpacklo_epi8(c10, zero), _mm256_unpacklo_epi8(c11, zero), exlo, eylo);
+		hi = _lerpAVX2(_mm256_unpackhi_epi8(c00, zero), _mm256_unpackhi_epi8(c01, zero),
+			_mm256_unpackhi_epi8(c10, zero), _mm256_unpackhi_epi8(c11, zero), exhi, eyhi);
+		_mm256_storeu_si256((__m256i *) &dp[i], _mm256_packus_epi16(lo, hi));
+	}
+	_bilinearScalar(ch, dp, i, n);
+}
+#endif
+
+/*!
+\brief Interpolates the first n pixels of a chunk into dp, with the best kernel for this CPU.
+*/
+static void (*_bilinear)(const tBilinearChunk *ch, tColorRGBA *dp, int n) = NULL;
+
+/*!
+\brief Guards the one-time choice of the bilinear kernel.
+*/
+static SDL_SpinLock _bilinearOnce = 0;
+
+/*!
+\brief Picks the bilinear kernel once, from any thread; called before any rows are handed to the worker pool.
+*/
+static void _bilinearSelect()
+{
+	void (*kernel)(const tBilinearChunk *ch, tColorRGBA *dp, int n);
+
+	SDL_AtomicLock(&_bilinearOnce);
+	if (_bilinear == NULL) {
+		kernel = _bilinearPortable;
+#if defined(ROTOZOOM_SSE2)
+		kernel = _bilinearSSE2;
+#endif
+#if defined(ROTOZOOM_AVX2)
+		if (SDL_HasAVX2()) {
+			kernel = _bilinearAVX2;
+		}
+#endif
+		_bilinear = kernel;
+	}
+	SDL_AtomicUnlock(&_bilinearOnce);
+}
+
+/*! 
+\brief Internal 32 bit integer-factor averaging Shrinker.
+
+Shrinks 32 bit RGBA/ABGR 'src' surface to 'dst' surface.
+Averages color and alpha values values of src pixels to calculate dst pixels.
+Assumes src and dst surfaces are of 32 bit depth.
+Assumes dst surface was allocated with the correct dimensions.
+Rows are split into bands processed on the worker pool.
+
+\param src The surface to shrink (input).
+\param dst The shrunken surface (output).
+\param factorx The horizontal shrinking ratio.
+\param factory The vertical shrinking ratio.
+
+\return 0 for success or -1 for error.
+*/
+int _shrinkSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int factorx, int factory)
+{
+	tShrinkJob job;
+
+	job.src = src;
+	job.dst = dst;
+	job.factorx = factorx;
+	job.factory = factory;
+	_parallelRows(_shrinkRowsRGBA, &job, dst->h, dst->w * dst->h);
 
 	return (0);
 }
@@ -284,104 +815,72 @@ int _shrinkSurfaceY(SDL_Surface * src, SDL_Surface * dst, int factorx, int facto
 	return (0);
 }
 
-/*! 
-\brief Internal 32 bit Zoomer with optional anti-aliasing by bilinear interpolation.
-
-Zooms 32 bit RGBA/ABGR 'src' surface to 'dst' surface.
-Assumes src and dst surfaces are of 32 bit depth.
-Assumes dst surface was allocated with the correct dimensions.
+/*!
+\brief Job for the row-parallel 32 bit zoomer.
+*/
+typedef struct tZoomJob {
+	SDL_Surface *src;
+	SDL_Surface *dst;
+	int flipx;
+	int flipy;
+	int smooth;
+	int *sax;
+	int *say;
+} tZoomJob;
 
-\param src The surface to zoom (input).
-\param dst The zoomed surface (output).
-\param flipx Flag indicating if the image should be horizontally flipped.
-\param flipy Flag indicating if the image should be vertically flipped.
-\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+/*!
+\brief Zooms destination rows y0 to y1 of a tZoomJob.
 
-\return 0 for success or -1 for error.
+The source row of the first destination row of the band is found through the
+accumulated row increments, so every band reads exactly the pixels the
+serial loop would.
 */
-int _zoomSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy, int smooth)
+static void _zoomRowsRGBA(void *data, int y0, int y1)
 {
-	int x, y, sx, sy, ssx, ssy, *sax, *say, *csax, *csay, *salast, csx, csy, ex, ey, cx, cy, sstep, sstepx, sstepy;
+	tZoomJob *job = (tZoomJob *) data;
+	SDL_Surface *src = job->src;
+	SDL_Surface *dst = job->dst;
+	int flipx = job->flipx;
+	int flipy = job->flipy;
+	int *sax = job->sax;
+	int *say = job->say;
+	int x, y, k, *csax, *csay, *salast, ex, ey, cx, cy, sstep, sstepx, sstepy;
 	tColorRGBA *c00, *c01, *c10, *c11;
 	tColorRGBA *sp, *csp, *dp;
-	int spixelgap, spixelw, spixelh, dgap, t1, t2;
+	int spixelgap, spixelw, spixelh, dgap;
+	tBilinearChunk chunk;
 
-	/*
-	* Allocate memory for row/column increments 
-	*/
-	if ((sax = (int *) malloc((dst->w + 1) * sizeof(int))) == NULL) {
-		return (-1);
-	}
-	if ((say = (int *) malloc((dst->h + 1) * sizeof(int))) == NULL) {
-		free(sax);
-		return (-1);
-	}
-
-	/*
-	* Precalculate row increments 
-	*/
 	spixelw = (src->w - 1);
 	spixelh = (src->h - 1);
-	if (smooth) {
-		sx = (int) (65536.0 * (float) spixelw / (float) (dst->w - 1));
-		sy = (int) (65536.0 * (float) spixelh / (float) (dst->h - 1));
-	} else {
-		sx = (int) (65536.0 * (float) (src->w) / (float) (dst->w));
-		sy = (int) (65536.0 * (float) (src->h) / (float) (dst->h));
-	}
-
-	/* Maximum scaled source size */
-	ssx = (src->w << 16) - 1;
-	ssy = (src->h << 16) - 1;
-
-	/* Precalculate horizontal row increments */
-	csx = 0;
-	csax = sax;
-	for (x = 0; x <= dst->w; x++) {
-		*csax = csx;
-		csax++;
-		csx += sx;
-
-		/* Guard from overflows */
-		if (csx > ssx) { 
-			csx = ssx; 
-		}
-	}
-
-	/* Precalculate vertical row increments */
-	csy = 0;
-	csay = say;
-	for (y = 0; y <= dst->h; y++) {
-		*csay = csy;
-		csay++;
-		csy += sy;
-
-		/* Guard from overflows */
-		if (csy > ssy) {
-			csy = ssy;
-		}
-	}
 
 	sp = (tColorRGBA *) src->pixels;
-	dp = (tColorRGBA *) dst->pixels;
+	dp = (tColorRGBA *) ((Uint8 *) dst->pixels + dst->pitch * y0);
 	dgap = dst->pitch - dst->w * 4;
 	spixelgap = src->pitch/4;
 
 	if (flipx) sp += spixelw;
 	if (flipy) sp += (spixelgap * spixelh);
 
+	sstep = (say[y0] >> 16) * spixelgap;
+	if (flipy) {
+		sp -= sstep;
+	} else {
+		sp += sstep;
+	}
+
 	/*
 	* Switch between interpolating and non-interpolating code 
 	*/
-	if (smooth) {
+	if (job->smooth) {
 
 		/*
 		* Interpolating Zoom 
 		*/
-		csay = say;
-		for (y = 0; y < dst->h; y++) {
+		csay = say + y0;
+		for (y = y0; y < y1; y++) {
 			csp = sp;
 			csax = sax;
+			k = 0;
 			for (x = 0; x < dst->w; x++) {
 				/*
 				* Setup color source pointers 
@@ -414,20 +913,15 @@ int _zoomSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy,
 				}
 
 				/*
-				* Draw and interpolate colors 
+				* Gather colors, interpolated a chunk at a time 
 				*/
-				t1 = ((((c01->r - c00->r) * ex) >> 16) + c00->r) & 0xff;
-				t2 = ((((c11->r - c10->r) * ex) >> 16) + c10->r) & 0xff;
-				dp->r = (((t2 - t1) * ey) >> 16) + t1;
-				t1 = ((((c01->g - c00->g) * ex) >> 16) + c00->g) & 0xff;
-				t2 = ((((c11->g - c10->g) * ex) >> 16) + c10->g) & 0xff;
-				dp->g = (((t2 - t1) * ey) >> 16) + t1;
-				t1 = ((((c01->b - c00->b) * ex) >> 16) + c00->b) & 0xff;
-				t2 = ((((c11->b - c10->b) * ex) >> 16) + c10->b) & 0xff;
-				dp->b = (((t2 - t1) * ey) >> 16) + t1;
-				t1 = ((((c01->a - c00->a) * ex) >> 16) + c00->a) & 0xff;
-				t2 = ((((c11->a - c10->a) * ex) >> 16) + c10->a) & 0xff;
-				dp->a = (((t2 - t1) * ey) >> 16) + t1;				
+				chunk.c00[k] = *c00;
+				chunk.c01[k] = *c01;
+				chunk.c10[k] = *c10;
+				chunk.c11[k] = *c11;
+				chunk.ex[k] = ex;
+				chunk.ey[k] = ey;
+				k++;
 				/*
 				* Advance source pointer x
 				*/
@@ -444,6 +938,13 @@ int _zoomSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy,
 				* Advance destination pointer x
 				*/
 				dp++;
+				if (k == BILINEAR_CHUNK) {
+					_bilinear(&chunk, dp - k, k);
+					k = 0;
+				}
+			}
+			if (k > 0) {
+				_bilinear(&chunk, dp - k, k);
 			}
 			/*
 			* Advance source pointer y
@@ -458,56 +959,171 @@ int _zoomSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy,
 				sp = csp + sstep;
 			}
 
-			/*
-			* Advance destination pointer y
-			*/
-			dp = (tColorRGBA *) ((Uint8 *) dp + dgap);
-		}
-	} else {
-		/*
-		* Non-Interpolating Zoom 
-		*/		
-		csay = say;
-		for (y = 0; y < dst->h; y++) {
-			csp = sp;
-			csax = sax;
-			for (x = 0; x < dst->w; x++) {
-				/*
-				* Draw 
-				*/
-				*dp = *sp;
+			/*
+			* Advance destination pointer y
+			*/
+			dp = (tColorRGBA *) ((Uint8 *) dp + dgap);
+		}
+	} else {
+		/*
+		* Non-Interpolating Zoom 
+		*/		
+		csay = say + y0;
+		for (y = y0; y < y1; y++) {
+			csp = sp;
+			csax = sax;
+			for (x = 0; x < dst->w; x++) {
+				/*
+				* Draw 
+				*/
+				*dp = *sp;
+
+				/*
+				* Advance source pointer x
+				*/
+				salast = csax;
+				csax++;				
+				sstep = (*csax >> 16) - (*salast >> 16);
+				if (flipx) sstep = -sstep;
+				sp += sstep;
+
+				/*
+				* Advance destination pointer x
+				*/
+				dp++;
+			}
+			/*
+			* Advance source pointer y
+			*/
+			salast = csay;
+			csay++;
+			sstep = (*csay >> 16) - (*salast >> 16);
+			sstep *= spixelgap;
+			if (flipy) sstep = -sstep;			
+			sp = csp + sstep;
+
+			/*
+			* Advance destination pointer y
+			*/
+			dp = (tColorRGBA *) ((Uint8 *) dp + dgap);
+		}
+	}
+}
+
+/*!
+\brief Precalculates the 16.16 row and column increments of a 32 bit zoom.
+
+\param srcw The source width.
+\param srch The source height.
+\param dstw The destination width.
+\param dsth The destination height.
+\param smooth Antialiasing flag; the increments differ when interpolating.
+\param sax Array of dstw + 1 column increments (output).
+\param say Array of dsth + 1 row increments (output).
+*/
+static void _zoomIncrements(int srcw, int srch, int dstw, int dsth, int smooth, int *sax, int *say)
+{
+	int x, y, sx, sy, ssx, ssy, *csax, *csay, csx, csy;
+	int spixelw, spixelh;
+
+	/*
+	* Precalculate row increments 
+	*/
+	spixelw = (srcw - 1);
+	spixelh = (srch - 1);
+	if (smooth) {
+		sx = (int) (65536.0 * (float) spixelw / (float) (dstw - 1));
+		sy = (int) (65536.0 * (float) spixelh / (float) (dsth - 1));
+	} else {
+		sx = (int) (65536.0 * (float) (srcw) / (float) (dstw));
+		sy = (int) (65536.0 * (float) (srch) / (float) (dsth));
+	}
+
+	/* Maximum scaled source size */
+	ssx = (srcw << 16) - 1;
+	ssy = (srch << 16) - 1;
+
+	/* Precalculate horizontal row increments */
+	csx = 0;
+	csax = sax;
+	for (x = 0; x <= dstw; x++) {
+		*csax = csx;
+		csax++;
+		csx += sx;
+
+		/* Guard from overflows */
+		if (csx > ssx) { 
+			csx = ssx; 
+		}
+	}
+
+	/* Precalculate vertical row increments */
+	csy = 0;
+	csay = say;
+	for (y = 0; y <= dsth; y++) {
+		*csay = csy;
+		csay++;
+		csy += sy;
+
+		/* Guard from overflows */
+		if (csy > ssy) {
+			csy = ssy;
+		}
+	}
+}
+
+/*!
+\brief Zooms 'src' into 'dst' on the worker pool with precalculated increments.
+*/
+static void _zoomRowsWithIncrements(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy, int smooth, int *sax, int *say)
+{
+	tZoomJob job;
+
+	job.src = src;
+	job.dst = dst;
+	job.flipx = flipx;
+	job.flipy = flipy;
+	job.smooth = smooth;
+	job.sax = sax;
+	job.say = say;
+	_bilinearSelect();
+	_parallelRows(_zoomRowsRGBA, &job, dst->h, dst->w * dst->h);
+}
+
+/*! 
+\brief Internal 32 bit Zoomer with optional anti-aliasing by bilinear interpolation.
+
+Zooms 32 bit RGBA/ABGR 'src' surface to 'dst' surface.
+Assumes src and dst surfaces are of 32 bit depth.
+Assumes dst surface was allocated with the correct dimensions.
+Rows are split into bands processed on the worker pool.
 
-				/*
-				* Advance source pointer x
-				*/
-				salast = csax;
-				csax++;				
-				sstep = (*csax >> 16) - (*salast >> 16);
-				if (flipx) sstep = -sstep;
-				sp += sstep;
+\param src The surface to zoom (input).
+\param dst The zoomed surface (output).
+\param flipx Flag indicating if the image should be horizontally flipped.
+\param flipy Flag indicating if the image should be vertically flipped.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
 
-				/*
-				* Advance destination pointer x
-				*/
-				dp++;
-			}
-			/*
-			* Advance source pointer y
-			*/
-			salast = csay;
-			csay++;
-			sstep = (*csay >> 16) - (*salast >> 16);
-			sstep *= spixelgap;
-			if (flipy) sstep = -sstep;			
-			sp = csp + sstep;
+\return 0 for success or -1 for error.
+*/
+int _zoomSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy, int smooth)
+{
+	int *sax, *say;
 
-			/*
-			* Advance destination pointer y
-			*/
-			dp = (tColorRGBA *) ((Uint8 *) dp + dgap);
-		}
+	/*
+	* Allocate memory for row/column increments 
+	*/
+	if ((sax = (int *) malloc((dst->w + 1) * sizeof(int))) == NULL) {
+		return (-1);
+	}
+	if ((say = (int *) malloc((dst->h + 1) * sizeof(int))) == NULL) {
+		free(sax);
+		return (-1);
 	}
 
+	_zoomIncrements(src->w, src->h, dst->w, dst->h, smooth, sax, say);
+	_zoomRowsWithIncrements(src, dst, flipx, flipy, smooth, sax, say);
+
 	/*
 	* Remove temp arrays 
 	*/
@@ -632,31 +1248,55 @@ int _zoomSurfaceY(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy)
 	return (0);
 }
 
-/*! 
-\brief Internal 32 bit rotozoomer with optional anti-aliasing.
+/*!
+\brief Job for the row-parallel 32 bit rotozoomer.
+*/
+typedef struct tTransformJob {
+	SDL_Surface *src;
+	SDL_Surface *dst;
+	int cx;
+	int cy;
+	int isin;
+	int icos;
+	int flipx;
+	int flipy;
+	int smooth;
+} tTransformJob;
 
-Rotates and zooms 32 bit RGBA/ABGR 'src' surface to 'dst' surface based on the control 
-parameters by scanning the destination surface and applying optionally anti-aliasing
-by bilinear interpolation.
-Assumes src and dst surfaces are of 32 bit depth.
-Assumes dst surface was allocated with the correct dimensions.
+/*!
+\brief Interpolates a chunk of gathered pixels and scatters them to their destinations.
+*/
+static void _transformFlush(const tBilinearChunk *ch, tColorRGBA **pcs, int n)
+{
+	tColorRGBA out[BILINEAR_CHUNK];
+	int i;
 
-\param src Source surface.
-\param dst Destination surface.
-\param cx Horizontal center coordinate.
-\param cy Vertical center coordinate.
-\param isin Integer version of sine of angle.
-\param icos Integer version of cosine of angle.
-\param flipx Flag indicating horizontal mirroring should be applied.
-\param flipy Flag indicating vertical mirroring should be applied.
-\param smooth Flag indicating anti-aliasing should be used.
+	_bilinear(ch, out, n);
+	for (i = 0; i < n; i++) {
+		*pcs[i] = out[i];
+	}
+}
+
+/*!
+\brief Rotozooms destination rows y0 to y1 of a tTransformJob.
 */
-void _transformSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy, int isin, int icos, int flipx, int flipy, int smooth)
+static void _transformRowsRGBA(void *data, int y0, int y1)
 {
-	int x, y, t1, t2, dx, dy, xd, yd, sdx, sdy, ax, ay, ex, ey, sw, sh;
+	tTransformJob *job = (tTransformJob *) data;
+	SDL_Surface *src = job->src;
+	SDL_Surface *dst = job->dst;
+	int cx = job->cx;
+	int cy = job->cy;
+	int isin = job->isin;
+	int icos = job->icos;
+	int flipx = job->flipx;
+	int flipy = job->flipy;
+	int x, y, k, dx, dy, xd, yd, sdx, sdy, ax, ay, sw, sh;
 	tColorRGBA c00, c01, c10, c11, cswap;
 	tColorRGBA *pc, *sp;
 	int gap;
+	tBilinearChunk chunk;
+	tColorRGBA *pcs[BILINEAR_CHUNK];
 
 	/*
 	* Variable setup 
@@ -667,14 +1307,15 @@ void _transformSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy,
 	ay = (cy << 16) - (isin * cx);
 	sw = src->w - 1;
 	sh = src->h - 1;
-	pc = (tColorRGBA*) dst->pixels;
+	pc = (tColorRGBA*) ((Uint8 *) dst->pixels + dst->pitch * y0);
 	gap = dst->pitch - dst->w * 4;
 
 	/*
 	* Switch between interpolating and non-interpolating code 
 	*/
-	if (smooth) {
-		for (y = 0; y < dst->h; y++) {
+	if (job->smooth) {
+		k = 0;
+		for (y = y0; y < y1; y++) {
 			dy = cy - y;
 			sdx = (ax + (isin * dy)) + xd;
 			sdy = (ay - (icos * dy)) + yd;
@@ -703,31 +1344,32 @@ void _transformSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy,
 						cswap = c01; c01=c11; c11=cswap;
 					}
 					/*
-					* Interpolate colors 
+					* Gather colors, interpolated a chunk at a time 
 					*/
-					ex = (sdx & 0xffff);
-					ey = (sdy & 0xffff);
-					t1 = ((((c01.r - c00.r) * ex) >> 16) + c00.r) & 0xff;
-					t2 = ((((c11.r - c10.r) * ex) >> 16) + c10.r) & 0xff;
-					pc->r = (((t2 - t1) * ey) >> 16) + t1;
-					t1 = ((((c01.g - c00.g) * ex) >> 16) + c00.g) & 0xff;
-					t2 = ((((c11.g - c10.g) * ex) >> 16) + c10.g) & 0xff;
-					pc->g = (((t2 - t1) * ey) >> 16) + t1;
-					t1 = ((((c01.b - c00.b) * ex) >> 16) + c00.b) & 0xff;
-					t2 = ((((c11.b - c10.b) * ex) >> 16) + c10.b) & 0xff;
-					pc->b = (((t2 - t1) * ey) >> 16) + t1;
-					t1 = ((((c01.a - c00.a) * ex) >> 16) + c00.a) & 0xff;
-					t2 = ((((c11.a - c10.a) * ex) >> 16) + c10.a) & 0xff;
-					pc->a = (((t2 - t1) * ey) >> 16) + t1;
+					chunk.c00[k] = c00;
+					chunk.c01[k] = c01;
+					chunk.c10[k] = c10;
+					chunk.c11[k] = c11;
+					chunk.ex[k] = (sdx & 0xffff);
+					chunk.ey[k] = (sdy & 0xffff);
+					pcs[k] = pc;
+					if (++k == BILINEAR_CHUNK) {
+						_transformFlush(&chunk, pcs, k);
+						k = 0;
+					}
 				}
 				sdx += icos;
 				sdy += isin;
 				pc++;
 			}
+			if (k > 0) {
+				_transformFlush(&chunk, pcs, k);
+				k = 0;
+			}
 			pc = (tColorRGBA *) ((Uint8 *) pc + gap);
 		}
 	} else {
-		for (y = 0; y < dst->h; y++) {
+		for (y = y0; y < y1; y++) {
 			dy = cy - y;
 			sdx = (ax + (isin * dy)) + xd;
 			sdy = (ay - (icos * dy)) + yd;
@@ -750,6 +1392,43 @@ void _transformSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy,
 	}
 }
 
+/*! 
+\brief Internal 32 bit rotozoomer with optional anti-aliasing.
+
+Rotates and zooms 32 bit RGBA/ABGR 'src' surface to 'dst' surface based on the control 
+parameters by scanning the destination surface and applying optionally anti-aliasing
+by bilinear interpolation.
+Assumes src and dst surfaces are of 32 bit depth.
+Assumes dst surface was allocated with the correct dimensions.
+Rows are split into bands processed on the worker pool.
+
+\param src Source surface.
+\param dst Destination surface.
+\param cx Horizontal center coordinate.
+\param cy Vertical center coordinate.
+\param isin Integer version of sine of angle.
+\param icos Integer version of cosine of angle.
+\param flipx Flag indicating horizontal mirroring should be applied.
+\param flipy Flag indicating vertical mirroring should be applied.
+\param smooth Flag indicating anti-aliasing should be used.
+*/
+void _transformSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy, int isin, int icos, int flipx, int flipy, int smooth)
+{
+	tTransformJob job;
+
+	job.src = src;
+	job.dst = dst;
+	job.cx = cx;
+	job.cy = cy;
+	job.isin = isin;
+	job.icos = icos;
+	job.flipx = flipx;
+	job.flipy = flipy;
+	job.smooth = smooth;
+	_bilinearSelect();
+	_parallelRows(_transformRowsRGBA, &job, dst->h, dst->w * dst->h);
+}
+
 /*!
 
 \brief Rotates and zooms 8 bit palette/Y 'src' surface to 'dst' surface without smoothing.
@@ -962,6 +1641,186 @@ SDL_Surface* rotateSurface90Degrees(SDL_Surface* src, int numClockwiseTurns)
 }
 
 
+/* ---- Zoom contexts */
+
+static SDL_Surface *_rotozoomSurfaceXY(ZoomContext *ctx, SDL_Surface *into, SDL_Surface * src, double angle, double zoomx, double zoomy, int smooth);
+static SDL_Surface *_zoomSurface(ZoomContext *ctx, SDL_Surface *into, SDL_Surface * src, double zoomx, double zoomy, int smooth);
+static SDL_Surface *_shrinkSurface(SDL_Surface *into, SDL_Surface *src, int factorx, int factory);
+
+/*!
+\brief Cached increment tables and destination surface for repeated zooms.
+
+The tables are keyed by source size, destination size and smoothing; flipping
+is applied while scanning and does not change them. The destination surface
+is kept as long as its size and pixel format match.
+*/
+struct ZoomContext {
+	int srcw, srch, dstw, dsth, smooth;
+	int *sax, *say;
+	int saxcap, saycap;
+	SDL_Surface *dst;
+};
+
+/*!
+\brief Creates an empty zoom context.
+
+\return The new context, or NULL if out of memory.
+*/
+ZoomContext *zoomContextCreate(void)
+{
+	ZoomContext *ctx = (ZoomContext *) calloc(1, sizeof(ZoomContext));
+
+	if (ctx != NULL) {
+		ctx->srcw = -1;
+	}
+	return ctx;
+}
+
+/*!
+\brief Frees a zoom context, including the last surface it returned.
+
+\param ctx The context to free; may be NULL.
+*/
+void zoomContextDestroy(ZoomContext *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+	free(ctx->sax);
+	free(ctx->say);
+	if (ctx->dst != NULL) {
+		SDL_FreeSurface(ctx->dst);
+	}
+	free(ctx);
+}
+
+/*!
+\brief Zooms with the context's increment tables, recalculating them only when the key changed.
+
+\return 0 for success or -1 for error.
+*/
+static int _zoomSurfaceRGBAContext(ZoomContext *ctx, SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy, int smooth)
+{
+	int *p;
+
+	if (ctx == NULL) {
+		return _zoomSurfaceRGBA(src, dst, flipx, flipy, smooth);
+	}
+
+	if (ctx->srcw != src->w || ctx->srch != src->h || ctx->dstw != dst->w || ctx->dsth != dst->h || ctx->smooth != smooth) {
+		if (ctx->saxcap < dst->w + 1) {
+			if ((p = (int *) realloc(ctx->sax, (dst->w + 1) * sizeof(int))) == NULL) {
+				return (-1);
+			}
+			ctx->sax = p;
+			ctx->saxcap = dst->w + 1;
+		}
+		if (ctx->saycap < dst->h + 1) {
+			if ((p = (int *) realloc(ctx->say, (dst->h + 1) * sizeof(int))) == NULL) {
+				return (-1);
+			}
+			ctx->say = p;
+			ctx->saycap = dst->h + 1;
+		}
+		_zoomIncrements(src->w, src->h, dst->w, dst->h, smooth, ctx->sax, ctx->say);
+		ctx->srcw = src->w;
+		ctx->srch = src->h;
+		ctx->dstw = dst->w;
+		ctx->dsth = dst->h;
+		ctx->smooth = smooth;
+	}
+
+	_zoomRowsWithIncrements(src, dst, flipx, flipy, smooth, ctx->sax, ctx->say);
+	return (0);
+}
+
+/*!
+\brief Checks that a surface has the given size and the source's format.
+*/
+static int _targetMatches(SDL_Surface *dst, SDL_Surface *src, int width, int height, int is32bit)
+{
+	if (dst->w != width || dst->h != height || dst->format->BitsPerPixel != (is32bit ? 32 : 8)) {
+		return 0;
+	}
+	return !is32bit || (dst->format->Rmask == src->format->Rmask && dst->format->Gmask == src->format->Gmask &&
+		dst->format->Bmask == src->format->Bmask && dst->format->Amask == src->format->Amask);
+}
+
+/*!
+\brief Returns a destination surface of the given size and the source's format.
+
+A caller provided surface is used if it matches and rejected otherwise. It
+needs no guard rows: the kernels behind the *Into() functions only write rows
+0 to h - 1 of the destination. Without one, a context's cached surface is
+reused when it matches, otherwise a new surface is allocated (with guard rows)
+and kept in the context.
+
+\param ctx The zoom context, or NULL.
+\param into The caller provided destination, or NULL.
+\param src The (32 or 8 bit) source surface.
+\param width The destination width.
+\param height The destination height.
+\param is32bit Whether the destination is 32 bit RGBA/ABGR or 8 bit.
+\param clear Whether a reused surface must be cleared, for transforms that don't write every pixel.
+
+\return The destination surface or NULL on error.
+*/
+static SDL_Surface *_createTarget(ZoomContext *ctx, SDL_Surface *into, SDL_Surface *src, int width, int height, int is32bit, int clear)
+{
+	SDL_Surface *dst;
+
+	if (into != NULL) {
+		if (into->pixels == NULL || !_targetMatches(into, src, width, height, is32bit)) {
+			return NULL;
+		}
+		dst = into;
+		if (clear) {
+			memset(dst->pixels, 0, dst->pitch * dst->h);
+		}
+		return dst;
+	}
+
+	if (ctx != NULL && ctx->dst != NULL) {
+		dst = ctx->dst;
+		if (_targetMatches(dst, src, width, height, is32bit)) {
+			if (clear) {
+				memset(dst->pixels, 0, dst->pitch * dst->h);
+			}
+			return dst;
+		}
+		SDL_FreeSurface(dst);
+		ctx->dst = NULL;
+	}
+
+	if (is32bit) {
+		/*
+		* Target surface is 32bit with source RGBA/ABGR ordering 
+		*/
+		dst =
+			SDL_CreateRGBSurface(SDL_SWSURFACE, width, height + GUARD_ROWS, 32,
+			src->format->Rmask, src->format->Gmask,
+			src->format->Bmask, src->format->Amask);
+	} else {
+		/*
+		* Target surface is 8bit 
+		*/
+		dst = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height + GUARD_ROWS, 8, 0, 0, 0, 0);
+	}
+
+	/* Check target */
+	if (dst == NULL) {
+		return NULL;
+	}
+
+	/* Adjust for guard rows */
+	dst->h = height;
+
+	if (ctx != NULL) {
+		ctx->dst = dst;
+	}
+	return dst;
+}
+
 /*!
 \brief Internal target surface sizing function for rotozooms with trig result return. 
 
@@ -1025,6 +1884,30 @@ void rotozoomSurfaceSizeXY(int width, int height, double angle, double zoomx, do
 	_rotozoomSurfaceSizeTrig(width, height, angle, zoomx, zoomy, dstwidth, dstheight, &dummy_sanglezoom, &dummy_canglezoom);
 }
 
+/*! 
+\brief Returns the size of the destination a rotozoomSurfaceXYInto() call needs.
+
+Unlike rotozoomSurfaceSizeXY(), this is the size rotozoomSurfaceXY() actually
+returns: for an angle of (nearly) zero it takes the plain zoom path, so the
+size is the one from zoomSurfaceSize().
+
+\param width The source surface width.
+\param height The source surface height.
+\param angle The angle to rotate in degrees.
+\param zoomx The horizontal scaling factor.
+\param zoomy The vertical scaling factor.
+\param dstwidth The calculated width of the destination surface.
+\param dstheight The calculated height of the destination surface.
+*/
+void rotozoomSurfaceXYIntoSize(int width, int height, double angle, double zoomx, double zoomy, int *dstwidth, int *dstheight)
+{
+	if (fabs(angle) <= VALUE_LIMIT) {
+		zoomSurfaceSize(width, height, zoomx, zoomy, dstwidth, dstheight);
+		return;
+	}
+	rotozoomSurfaceSizeXY(width, height, angle, zoomx, zoomy, dstwidth, dstheight);
+}
+
 /*! 
 \brief Returns the size of the resulting target surface for a rotozoomSurface() call. 
 
@@ -1079,6 +1962,72 @@ or 32bit RGBA/ABGR it will be converted into a 32bit RGBA format on the fly.
 \return The new rotozoomed surface.
 */
 SDL_Surface *rotozoomSurfaceXY(SDL_Surface * src, double angle, double zoomx, double zoomy, int smooth)
+{
+	return _rotozoomSurfaceXY(NULL, NULL, src, angle, zoomx, zoomy, smooth);
+}
+
+/*!
+\brief Rotates and zooms a surface into a destination owned by a zoom context.
+
+Like rotozoomSurfaceXY(), but the returned surface belongs to 'ctx' and is
+reused by the next call with the same destination size and format, so
+repeated rotozooms of a 32bit or 8bit source do no allocation. The returned
+surface must not be freed and is only valid until the next call on 'ctx'.
+
+\param ctx The zoom context.
+\param src The surface to rotozoom.
+\param angle The angle to rotate in degrees.
+\param zoomx The horizontal scaling factor.
+\param zoomy The vertical scaling factor.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+
+\return The rotozoomed surface owned by the context.
+*/
+SDL_Surface *rotozoomSurfaceXYCached(ZoomContext *ctx, SDL_Surface * src, double angle, double zoomx, double zoomy, int smooth)
+{
+	if (ctx == NULL) {
+		return (NULL);
+	}
+	return _rotozoomSurfaceXY(ctx, NULL, src, angle, zoomx, zoomy, smooth);
+}
+
+/*!
+\brief Rotates and zooms a surface into a caller provided destination.
+
+Like rotozoomSurfaceXY(), but renders into 'dst' instead of a new surface.
+'dst' must be exactly the size returned by rotozoomSurfaceXYIntoSize() and have
+the format rotozoomSurfaceXY() would create: 8bit for an 8bit source, else
+32bit with the masks of the source (or of the RGBA ordering used for
+converted sources). Its pixels must be accessible, i.e. the surface is locked
+if it needs locking. Pixels not covered by the rotated source are cleared.
+Only the 'h' rows of 'dst' are written, so a buffer of exactly h * pitch
+bytes, such as a locked texture, is enough.
+
+To render straight into a locked streaming texture, wrap its pixels once with
+SDL_CreateRGBSurfaceWithFormatFrom() and update the 'pixels' and 'pitch'
+fields after each SDL_LockTexture().
+
+\param src The surface to rotozoom.
+\param dst The destination surface.
+\param angle The angle to rotate in degrees.
+\param zoomx The horizontal scaling factor.
+\param zoomy The vertical scaling factor.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+
+\return 0 on success or -1 if 'dst' doesn't match or on error.
+*/
+int rotozoomSurfaceXYInto(SDL_Surface * src, SDL_Surface * dst, double angle, double zoomx, double zoomy, int smooth)
+{
+	if (dst == NULL) {
+		return (-1);
+	}
+	return (_rotozoomSurfaceXY(NULL, dst, src, angle, zoomx, zoomy, smooth) == NULL) ? -1 : 0;
+}
+
+/*!
+\brief Internal rotozoomer behind rotozoomSurfaceXY(), rotozoomSurfaceXYCached() and rotozoomSurfaceXYInto().
+*/
+static SDL_Surface *_rotozoomSurfaceXY(ZoomContext *ctx, SDL_Surface *into, SDL_Surface * src, double angle, double zoomx, double zoomy, int smooth)
 {
 	SDL_Surface *rz_src;
 	SDL_Surface *rz_dst;
@@ -1164,30 +2113,17 @@ SDL_Surface *rotozoomSurfaceXY(SDL_Surface * src, double angle, double zoomx, do
 		dstheighthalf = dstheight / 2;
 
 		/*
-		* Alloc space to completely contain the rotated surface 
-		*/
-		rz_dst = NULL;
-		if (is32bit) {
-			/*
-			* Target surface is 32bit with source RGBA/ABGR ordering 
-			*/
-			rz_dst =
-				SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 32,
-				rz_src->format->Rmask, rz_src->format->Gmask,
-				rz_src->format->Bmask, rz_src->format->Amask);
-		} else {
-			/*
-			* Target surface is 8bit 
-			*/
-			rz_dst = SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 8, 0, 0, 0, 0);
-		}
+		* Alloc space to completely contain the rotated surface 
+		*/
+		rz_dst = _createTarget(ctx, into, rz_src, dstwidth, dstheight, is32bit, 1);
 
 		/* Check target */
-		if (rz_dst == NULL)
+		if (rz_dst == NULL) {
+			if (src_converted) {
+				SDL_FreeSurface(rz_src);
+			}
 			return NULL;
-
-		/* Adjust for guard rows */
-		rz_dst->h = dstheight;
+		}
 
 		/*
 		* Lock source surface 
@@ -1246,28 +2182,15 @@ SDL_Surface *rotozoomSurfaceXY(SDL_Surface * src, double angle, double zoomx, do
 		/*
 		* Alloc space to completely contain the zoomed surface 
 		*/
-		rz_dst = NULL;
-		if (is32bit) {
-			/*
-			* Target surface is 32bit with source RGBA/ABGR ordering 
-			*/
-			rz_dst =
-				SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 32,
-				rz_src->format->Rmask, rz_src->format->Gmask,
-				rz_src->format->Bmask, rz_src->format->Amask);
-		} else {
-			/*
-			* Target surface is 8bit 
-			*/
-			rz_dst = SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 8, 0, 0, 0, 0);
-		}
+		rz_dst = _createTarget(ctx, into, rz_src, dstwidth, dstheight, is32bit, 0);
 
 		/* Check target */
-		if (rz_dst == NULL)
+		if (rz_dst == NULL) {
+			if (src_converted) {
+				SDL_FreeSurface(rz_src);
+			}
 			return NULL;
-
-		/* Adjust for guard rows */
-		rz_dst->h = dstheight;
+		}
 
 		/*
 		* Lock source surface 
@@ -1283,7 +2206,7 @@ SDL_Surface *rotozoomSurfaceXY(SDL_Surface * src, double angle, double zoomx, do
 			/*
 			* Call the 32bit transformation routine to do the zooming (using alpha) 
 			*/
-			_zoomSurfaceRGBA(rz_src, rz_dst, flipx, flipy, smooth);
+			_zoomSurfaceRGBAContext(ctx, rz_src, rz_dst, flipx, flipy, smooth);
 
 		} else {
 			/*
@@ -1384,6 +2307,62 @@ If zoom factors are negative, the image is flipped on the axes.
 \return The new, zoomed surface.
 */
 SDL_Surface *zoomSurface(SDL_Surface * src, double zoomx, double zoomy, int smooth)
+{
+	return _zoomSurface(NULL, NULL, src, zoomx, zoomy, smooth);
+}
+
+/*!
+\brief Zooms a surface into a destination owned by a zoom context.
+
+Like zoomSurface(), but the increment tables and the destination surface are
+cached in 'ctx', keyed by source size, destination size and smoothing, so
+repeated zooms of a 32bit or 8bit source at a fixed scale do no allocation.
+The returned surface must not be freed and is only valid until the next
+call on 'ctx'.
+
+\param ctx The zoom context.
+\param src The surface to zoom.
+\param zoomx The horizontal zoom factor.
+\param zoomy The vertical zoom factor.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+
+\return The zoomed surface owned by the context.
+*/
+SDL_Surface *zoomSurfaceCached(ZoomContext *ctx, SDL_Surface * src, double zoomx, double zoomy, int smooth)
+{
+	if (ctx == NULL) {
+		return (NULL);
+	}
+	return _zoomSurface(ctx, NULL, src, zoomx, zoomy, smooth);
+}
+
+/*!
+\brief Zooms a surface into a caller provided destination.
+
+Like zoomSurface(), but renders into 'dst' instead of a new surface. 'dst'
+must be exactly the size returned by zoomSurfaceSize() and have the format
+described for rotozoomSurfaceXYInto(); every pixel is overwritten.
+
+\param src The surface to zoom.
+\param dst The destination surface.
+\param zoomx The horizontal zoom factor.
+\param zoomy The vertical zoom factor.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+
+\return 0 on success or -1 if 'dst' doesn't match or on error.
+*/
+int zoomSurfaceInto(SDL_Surface * src, SDL_Surface * dst, double zoomx, double zoomy, int smooth)
+{
+	if (dst == NULL) {
+		return (-1);
+	}
+	return (_zoomSurface(NULL, dst, src, zoomx, zoomy, smooth) == NULL) ? -1 : 0;
+}
+
+/*!
+\brief Internal zoomer behind zoomSurface(), zoomSurfaceCached() and zoomSurfaceInto().
+*/
+static SDL_Surface *_zoomSurface(ZoomContext *ctx, SDL_Surface *into, SDL_Surface * src, double zoomx, double zoomy, int smooth)
 {
 	SDL_Surface *rz_src;
 	SDL_Surface *rz_dst;
@@ -1439,21 +2418,7 @@ SDL_Surface *zoomSurface(SDL_Surface * src, double zoomx, double zoomy, int smoo
 	/*
 	* Alloc space to completely contain the zoomed surface 
 	*/
-	rz_dst = NULL;
-	if (is32bit) {
-		/*
-		* Target surface is 32bit with source RGBA/ABGR ordering 
-		*/
-		rz_dst =
-			SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 32,
-			rz_src->format->Rmask, rz_src->format->Gmask,
-			rz_src->format->Bmask, rz_src->format->Amask);
-	} else {
-		/*
-		* Target surface is 8bit 
-		*/
-		rz_dst = SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 8, 0, 0, 0, 0);
-	}
+	rz_dst = _createTarget(ctx, into, rz_src, dstwidth, dstheight, is32bit, 0);
 
 	/* Check target */
 	if (rz_dst == NULL) {
@@ -1466,9 +2431,6 @@ SDL_Surface *zoomSurface(SDL_Surface * src, double zoomx, double zoomy, int smoo
 		return NULL;
 	}
 
-	/* Adjust for guard rows */
-	rz_dst->h = dstheight;
-
 	/*
 	* Lock source surface 
 	*/
@@ -1483,7 +2445,7 @@ SDL_Surface *zoomSurface(SDL_Surface * src, double zoomx, double zoomy, int smoo
 		/*
 		* Call the 32bit transformation routine to do the zooming (using alpha) 
 		*/
-		_zoomSurfaceRGBA(rz_src, rz_dst, flipx, flipy, smooth);
+		_zoomSurfaceRGBAContext(ctx, rz_src, rz_dst, flipx, flipy, smooth);
 	} else {
 		/*
 		* Copy palette and colorkey info 
@@ -1535,6 +2497,52 @@ The input surface is not modified. The output surface is newly allocated.
 */
 /*@null@*/ 
 SDL_Surface *shrinkSurface(SDL_Surface *src, int factorx, int factory)
+{
+	return _shrinkSurface(NULL, src, factorx, factory);
+}
+
+/*!
+\brief Shrinks a surface into a caller provided destination.
+
+Like shrinkSurface(), but renders into 'dst' instead of a new surface. 'dst'
+must be exactly the size returned by shrinkSurfaceSize() and have the format
+described for rotozoomSurfaceXYInto().
+
+\param src The surface to shrink.
+\param dst The destination surface.
+\param factorx The horizontal shrinking ratio.
+\param factory The vertical shrinking ratio.
+
+\return 0 on success or -1 if 'dst' doesn't match or on error.
+*/
+int shrinkSurfaceInto(SDL_Surface *src, SDL_Surface *dst, int factorx, int factory)
+{
+	if (dst == NULL) {
+		return (-1);
+	}
+	return (_shrinkSurface(dst, src, factorx, factory) == NULL) ? -1 : 0;
+}
+
+/*!
+\brief Calculates the size of the target surface for a shrinkSurface() call.
+
+\param width The width of the source surface to shrink.
+\param height The height of the source surface to shrink.
+\param factorx The horizontal shrinking ratio.
+\param factory The vertical shrinking ratio.
+\param dstwidth Pointer to an integer to store the calculated width of the shrunken target surface.
+\param dstheight Pointer to an integer to store the calculated height of the shrunken target surface.
+*/
+void shrinkSurfaceSize(int width, int height, int factorx, int factory, int *dstwidth, int *dstheight)
+{
+	*dstwidth = width / factorx;
+	*dstheight = height / factory;
+}
+
+/*!
+\brief Internal shrinker behind shrinkSurface() and shrinkSurfaceInto().
+*/
+static SDL_Surface *_shrinkSurface(SDL_Surface *into, SDL_Surface *src, int factorx, int factory)
 {
 	int result;
 	SDL_Surface *rz_src;
@@ -1593,29 +2601,13 @@ SDL_Surface *shrinkSurface(SDL_Surface *src, int factorx, int factory)
 	}
 
 	/* Get size for target */
-	dstwidth=rz_src->w/factorx;
-	while (dstwidth*factorx>rz_src->w) { dstwidth--; }
-	dstheight=rz_src->h/factory;
-	while (dstheight*factory>rz_src->h) { dstheight--; }
+	shrinkSurfaceSize(rz_src->w, rz_src->h, factorx, factory, &dstwidth, &dstheight);
 
 	/*
 	* Alloc space to completely contain the shrunken surface
 	* (with added guard rows)
 	*/
-	if (is32bit==1) {
-		/*
-		* Target surface is 32bit with source RGBA/ABGR ordering 
-		*/
-		rz_dst =
-			SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 32,
-			rz_src->format->Rmask, rz_src->format->Gmask,
-			rz_src->format->Bmask, rz_src->format->Amask);
-	} else {
-		/*
-		* Target surface is 8bit 
-		*/
-		rz_dst = SDL_CreateRGBSurface(SDL_SWSURFACE, dstwidth, dstheight + GUARD_ROWS, 8, 0, 0, 0, 0);
-	}
+	rz_dst = _createTarget(NULL, into, rz_src, dstwidth, dstheight, is32bit, 0);
 
 	/* Check target */
 	if (rz_dst == NULL) {
@@ -1623,9 +2615,6 @@ SDL_Surface *shrinkSurface(SDL_Surface *src, int factorx, int factory)
 		goto exitShrinkSurface;
 	}
 
-	/* Adjust for guard rows */
-	rz_dst->h = dstheight;
-
 	/*
 	* Check which kind of surface we have 
 	*/
@@ -1675,7 +2664,7 @@ exitShrinkSurface:
 
 	/* Check error state; maybe need to cleanup destination */
 	if (haveError==1) {
-		if (rz_dst!=NULL) {
+		if (rz_dst!=NULL && rz_dst!=into) {
 			SDL_FreeSurface(rz_dst);
 		}
 		rz_dst=NULL;
@@ -1686,3 +2675,355 @@ exitShrinkSurface:
 	*/
 	return (rz_dst);
 }
+
+/* ---- Mip chains */
+
+/*!
+\brief Maximum number of levels in a mip chain, enough for any int sized surface.
+*/
+#define MIPCHAIN_MAX_LEVELS 32
+
+/*!
+\brief A source surface and its successive half size reductions.
+
+Level 0 is the caller's source surface; the chain owns the others.
+*/
+struct MipChain {
+	int nlevels;
+	SDL_Surface *levels[MIPCHAIN_MAX_LEVELS];
+};
+
+/*!
+\brief Builds the power-of-two downscale chain of a surface.
+
+Each level halves the previous one with shrinkSurface() until a side would
+drop below one pixel, so building the chain reads the full resolution
+source only once. The source is kept as level 0 and must outlive the chain.
+
+\param src The (32 or 8 bit) source surface.
+
+\return The new chain, or NULL on error.
+*/
+MipChain *mipChainCreate(SDL_Surface *src)
+{
+	MipChain *chain;
+	SDL_Surface *prev;
+
+	if (src == NULL) {
+		return (NULL);
+	}
+	if ((chain = (MipChain *) calloc(1, sizeof(MipChain))) == NULL) {
+		return (NULL);
+	}
+
+	chain->levels[0] = src;
+	chain->nlevels = 1;
+	prev = src;
+	while (chain->nlevels < MIPCHAIN_MAX_LEVELS && prev->w >= 2 && prev->h >= 2) {
+		if ((prev = shrinkSurface(prev, 2, 2)) == NULL) {
+			mipChainDestroy(chain);
+			return (NULL);
+		}
+		chain->levels[chain->nlevels++] = prev;
+	}
+
+	return chain;
+}
+
+/*!
+\brief Frees a mip chain and all of its levels except the source.
+
+\param chain The chain to free; may be NULL.
+*/
+void mipChainDestroy(MipChain *chain)
+{
+	int i;
+
+	if (chain == NULL) {
+		return;
+	}
+	for (i = 1; i < chain->nlevels; i++) {
+		SDL_FreeSurface(chain->levels[i]);
+	}
+	free(chain);
+}
+
+/*!
+\brief Returns the number of levels in a mip chain, including the source.
+*/
+int mipChainLevels(MipChain *chain)
+{
+	return (chain == NULL) ? 0 : chain->nlevels;
+}
+
+/*!
+\brief Returns a level of a mip chain; level 0 is the source.
+
+\return The level surface owned by the chain, or NULL if out of range.
+*/
+SDL_Surface *mipChainLevel(MipChain *chain, int level)
+{
+	if (chain == NULL || level < 0 || level >= chain->nlevels) {
+		return (NULL);
+	}
+	return chain->levels[level];
+}
+
+/*!
+\brief Picks the smallest level that is still at least as large as the zoomed source.
+
+The less reduced axis decides, so neither axis gets upscaled from a level
+smaller than the result.
+
+\param chain The mip chain.
+\param zoomx The horizontal zoom factor relative to the source.
+\param zoomy The vertical zoom factor relative to the source.
+
+\return The level index.
+*/
+int mipChainSelect(MipChain *chain, double zoomx, double zoomy)
+{
+	double zoom;
+	int level;
+
+	if (chain == NULL) {
+		return 0;
+	}
+
+	zoom = MAX(fabs(zoomx), fabs(zoomy));
+	level = 0;
+	while (level + 1 < chain->nlevels && zoom <= 0.5) {
+		zoom *= 2.0;
+		level++;
+	}
+	return level;
+}
+
+/*!
+\brief Zooms the source of a mip chain, starting from the nearest level.
+
+The result has the size zoomSurface() would give for the source, but only
+the selected level is read. Negative factors flip as in zoomSurface().
+
+\param chain The mip chain.
+\param zoomx The horizontal zoom factor relative to the source.
+\param zoomy The vertical zoom factor relative to the source.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+
+\return The new, zoomed surface.
+*/
+SDL_Surface *mipChainZoom(MipChain *chain, double zoomx, double zoomy, int smooth)
+{
+	SDL_Surface *src, *level;
+	int dstwidth, dstheight;
+
+	if (chain == NULL) {
+		return (NULL);
+	}
+
+	src = chain->levels[0];
+	level = chain->levels[mipChainSelect(chain, zoomx, zoomy)];
+	if (level == src) {
+		return zoomSurface(src, zoomx, zoomy, smooth);
+	}
+
+	/* Rescale the factors so the level zooms to the source's target size */
+	zoomSurfaceSize(src->w, src->h, zoomx, zoomy, &dstwidth, &dstheight);
+	zoomx = (zoomx < 0.0 ? -1.0 : 1.0) * ((double) dstwidth / (double) level->w);
+	zoomy = (zoomy < 0.0 ? -1.0 : 1.0) * ((double) dstheight / (double) level->h);
+
+	return zoomSurface(level, zoomx, zoomy, smooth);
+}
+
+/* ---- Renderer rotozoom */
+
+/*!
+\brief A source surface prepared for repeated rotozooms onto a renderer.
+
+On an accelerated renderer 'texture' holds the uploaded source and SDL does
+the transform. On the software renderer the CPU rotozoomer renders through
+'ctx' and 'texture' is a streaming texture holding the last result.
+*/
+struct RotozoomTexture {
+	SDL_Renderer *renderer;
+	SDL_Surface *src;
+	SDL_Surface *converted;
+	SDL_Texture *texture;
+	ZoomContext *ctx;
+	int software;
+	int texw, texh;
+};
+
+/*!
+\brief Prepares a surface for rotozooming onto a renderer.
+
+On an accelerated renderer the surface is uploaded once to a texture. On the
+software renderer it is kept for the CPU rotozoomer, converted to 32bit if
+needed. The surface must outlive the handle; call rotozoomTextureUpdate()
+after changing its pixels.
+
+\param renderer The renderer to draw to.
+\param src The source surface.
+
+\return The new handle, or NULL on error.
+*/
+RotozoomTexture *rotozoomTextureCreate(SDL_Renderer *renderer, SDL_Surface *src)
+{
+	RotozoomTexture *rt;
+	SDL_RendererInfo info;
+
+	if (renderer == NULL || src == NULL) {
+		return (NULL);
+	}
+	if (SDL_GetRendererInfo(renderer, &info) < 0) {
+		return (NULL);
+	}
+	if ((rt = (RotozoomTexture *) calloc(1, sizeof(RotozoomTexture))) == NULL) {
+		return (NULL);
+	}
+
+	rt->renderer = renderer;
+	rt->src = src;
+	rt->software = (info.flags & SDL_RENDERER_SOFTWARE) != 0;
+	if (rt->software && (rt->ctx = zoomContextCreate()) == NULL) {
+		free(rt);
+		return (NULL);
+	}
+	if (rotozoomTextureUpdate(rt) < 0) {
+		rotozoomTextureDestroy(rt);
+		return (NULL);
+	}
+
+	return rt;
+}
+
+/*!
+\brief Frees a renderer rotozoom handle and its texture; the source surface is left alone.
+
+\param rt The handle to free; may be NULL.
+*/
+void rotozoomTextureDestroy(RotozoomTexture *rt)
+{
+	if (rt == NULL) {
+		return;
+	}
+	if (rt->texture != NULL) {
+		SDL_DestroyTexture(rt->texture);
+	}
+	if (rt->converted != NULL) {
+		SDL_FreeSurface(rt->converted);
+	}
+	zoomContextDestroy(rt->ctx);
+	free(rt);
+}
+
+/*!
+\brief Picks up changes to the pixels of the source surface.
+
+\param rt The handle.
+
+\return 0 on success or -1 on error.
+*/
+int rotozoomTextureUpdate(RotozoomTexture *rt)
+{
+	if (rt == NULL) {
+		return (-1);
+	}
+
+	if (!rt->software) {
+		if (rt->texture != NULL) {
+			SDL_DestroyTexture(rt->texture);
+		}
+		if ((rt->texture = SDL_CreateTextureFromSurface(rt->renderer, rt->src)) == NULL) {
+			return (-1);
+		}
+		SDL_SetTextureBlendMode(rt->texture, SDL_BLENDMODE_BLEND);
+		return (0);
+	}
+
+	/* Streaming textures can't be paletted, so the CPU path works in 32bit */
+	if (rt->src->format->BitsPerPixel != 32) {
+		if (rt->converted != NULL) {
+			SDL_FreeSurface(rt->converted);
+		}
+		if ((rt->converted = SDL_ConvertSurfaceFormat(rt->src, SDL_PIXELFORMAT_RGBA32, 0)) == NULL) {
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/*!
+\brief Draws the source rotated and zoomed, centered on a point.
+
+The result matches rotozoomSurfaceXY() placed with its center at (x, y):
+'angle' is counterclockwise in degrees and negative zoom factors flip. On an
+accelerated renderer the texture is drawn with SDL_RenderCopyExF() and
+'smooth' selects linear filtering; on the software renderer the CPU
+rotozoomer is used and its result uploaded.
+
+\param rt The handle.
+\param x The X coordinate of the center of the result.
+\param y The Y coordinate of the center of the result.
+\param angle The angle to rotate in degrees.
+\param zoomx The horizontal scaling factor.
+\param zoomy The vertical scaling factor.
+\param smooth Antialiasing flag; set to SMOOTHING_ON to enable.
+
+\return 0 on success or -1 on error.
+*/
+int rotozoomTextureRender(RotozoomTexture *rt, float x, float y, double angle, double zoomx, double zoomy, int smooth)
+{
+	SDL_Surface *rz;
+	SDL_FRect rect;
+	int flip;
+
+	if (rt == NULL) {
+		return (-1);
+	}
+
+	if (!rt->software) {
+		flip = SDL_FLIP_NONE;
+		if (zoomx < 0.0) {
+			flip |= SDL_FLIP_HORIZONTAL;
+			zoomx = -zoomx;
+		}
+		if (zoomy < 0.0) {
+			flip |= SDL_FLIP_VERTICAL;
+			zoomy = -zoomy;
+		}
+		rect.w = (float) (rt->src->w * zoomx);
+		rect.h = (float) (rt->src->h * zoomy);
+		rect.x = x - rect.w / 2.0f;
+		rect.y = y - rect.h / 2.0f;
+		SDL_SetTextureScaleMode(rt->texture, smooth ? SDL_ScaleModeLinear : SDL_ScaleModeNearest);
+		return SDL_RenderCopyExF(rt->renderer, rt->texture, NULL, &rect, -angle, NULL, (SDL_RendererFlip) flip);
+	}
+
+	rz = rotozoomSurfaceXYCached(rt->ctx, rt->converted != NULL ? rt->converted : rt->src, angle, zoomx, zoomy, smooth);
+	if (rz == NULL) {
+		return (-1);
+	}
+
+	if (rt->texture == NULL || rt->texw != rz->w || rt->texh != rz->h) {
+		if (rt->texture != NULL) {
+			SDL_DestroyTexture(rt->texture);
+		}
+		rt->texture = SDL_CreateTexture(rt->renderer, rz->format->format, SDL_TEXTUREACCESS_STREAMING, rz->w, rz->h);
+		if (rt->texture == NULL) {
+			return (-1);
+		}
+		SDL_SetTextureBlendMode(rt->texture, SDL_BLENDMODE_BLEND);
+		rt->texw = rz->w;
+		rt->texh = rz->h;
+	}
+	if (SDL_UpdateTexture(rt->texture, NULL, rz->pixels, rz->pitch) < 0) {
+		return (-1);
+	}
+
+	rect.w = (float) rz->w;
+	rect.h = (float) rz->h;
+	rect.x = x - rect.w / 2.0f;
+	rect.y = y - rect.h / 2.0f;
+	return SDL_RenderCopyF(rt->renderer, rt->texture, NULL, &rect);
+}
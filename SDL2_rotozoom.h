@@ -55,6 +55,23 @@ extern "C" {
 	*/
 #define SMOOTHING_ON		1
 
+	/* ---- Structures */
+
+	/*!
+	\brief Cached tables and destination surface for repeated zooms; see zoomContextCreate().
+	*/
+	typedef struct ZoomContext ZoomContext;
+
+	/*!
+	\brief A surface with its power-of-two downscales; see mipChainCreate().
+	*/
+	typedef struct MipChain MipChain;
+
+	/*!
+	\brief A surface prepared for rotozooming onto a renderer; see rotozoomTextureCreate().
+	*/
+	typedef struct RotozoomTexture RotozoomTexture;
+
 	/* ---- Function Prototypes */
 
 #ifdef _MSC_VER
@@ -107,6 +124,8 @@ extern "C" {
 
 	SDL2_ROTOZOOM_SCOPE SDL_Surface *shrinkSurface(SDL_Surface * src, int factorx, int factory);
 
+	SDL2_ROTOZOOM_SCOPE void shrinkSurfaceSize(int width, int height, int factorx, int factory, int *dstwidth, int *dstheight);
+
 	/* 
 
 	Specialized rotation functions
@@ -115,6 +134,81 @@ extern "C" {
 
 	SDL2_ROTOZOOM_SCOPE SDL_Surface* rotateSurface90Degrees(SDL_Surface* src, int numClockwiseTurns);
 
+	/* 
+
+	Cached (allocation free) functions
+
+	*/
+
+	SDL2_ROTOZOOM_SCOPE ZoomContext *zoomContextCreate(void);
+
+	SDL2_ROTOZOOM_SCOPE void zoomContextDestroy(ZoomContext *ctx);
+
+	SDL2_ROTOZOOM_SCOPE SDL_Surface *zoomSurfaceCached(ZoomContext *ctx, SDL_Surface * src, double zoomx, double zoomy, int smooth);
+
+	SDL2_ROTOZOOM_SCOPE SDL_Surface *rotozoomSurfaceXYCached
+		(ZoomContext *ctx, SDL_Surface * src, double angle, double zoomx, double zoomy, int smooth);
+
+	/* 
+
+	Caller provided destination functions
+
+	*/
+
+	SDL2_ROTOZOOM_SCOPE int zoomSurfaceInto(SDL_Surface * src, SDL_Surface * dst, double zoomx, double zoomy, int smooth);
+
+	SDL2_ROTOZOOM_SCOPE int rotozoomSurfaceXYInto
+		(SDL_Surface * src, SDL_Surface * dst, double angle, double zoomx, double zoomy, int smooth);
+
+	SDL2_ROTOZOOM_SCOPE void rotozoomSurfaceXYIntoSize
+		(int width, int height, double angle, double zoomx, double zoomy, 
+		int *dstwidth, int *dstheight);
+
+	SDL2_ROTOZOOM_SCOPE int shrinkSurfaceInto(SDL_Surface * src, SDL_Surface * dst, int factorx, int factory);
+
+	/* 
+
+	Mipmap functions
+
+	*/
+
+	SDL2_ROTOZOOM_SCOPE MipChain *mipChainCreate(SDL_Surface * src);
+
+	SDL2_ROTOZOOM_SCOPE void mipChainDestroy(MipChain *chain);
+
+	SDL2_ROTOZOOM_SCOPE int mipChainLevels(MipChain *chain);
+
+	SDL2_ROTOZOOM_SCOPE SDL_Surface *mipChainLevel(MipChain *chain, int level);
+
+	SDL2_ROTOZOOM_SCOPE int mipChainSelect(MipChain *chain, double zoomx, double zoomy);
+
+	SDL2_ROTOZOOM_SCOPE SDL_Surface *mipChainZoom(MipChain *chain, double zoomx, double zoomy, int smooth);
+
+	/* 
+
+	Renderer functions
+
+	*/
+
+	SDL2_ROTOZOOM_SCOPE RotozoomTexture *rotozoomTextureCreate(SDL_Renderer * renderer, SDL_Surface * src);
+
+	SDL2_ROTOZOOM_SCOPE void rotozoomTextureDestroy(RotozoomTexture *rt);
+
+	SDL2_ROTOZOOM_SCOPE int rotozoomTextureUpdate(RotozoomTexture *rt);
+
+	SDL2_ROTOZOOM_SCOPE int rotozoomTextureRender
+		(RotozoomTexture *rt, float x, float y, double angle, double zoomx, double zoomy, int smooth);
+
+	/* 
+
+	Threading functions
+
+	*/
+
+	SDL2_ROTOZOOM_SCOPE void rotozoomSetThreads(int nthreads);
+
+	SDL2_ROTOZOOM_SCOPE int rotozoomGetThreads(void);
+
 	/* Ends C function definitions when using C++ */
 #ifdef __cplusplus
 }
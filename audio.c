@@ -0,0 +1,696 @@
+#ifdef SOUND
+#include <fluidsynth.h>
+#endif
+#ifdef WORKLET
+#include <emscripten/webaudio.h>
+#endif
+#ifdef EMSCRIPTEN
+#include <emscripten.h>
+#include <sys/stat.h>
+#endif
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "audio.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* note events travel from the physics thread to the audio thread through a
+ * single-producer/single-consumer ring. head is only written by the producer
+ * and tail only by the consumer, so neither side ever takes a lock */
+#define NOTEQ_LEN 1024
+
+struct note {
+	Uint64 time; /* in samples, on the simulation clock */
+	Uint8 key, vel;
+};
+
+static struct note noteq[NOTEQ_LEN];
+static SDL_atomic_t noteq_head, noteq_tail;
+static SDL_atomic_t noteq_overflows;
+
+/* the notes of the current frame, before merging and budgeting */
+#define PENDING_LEN 1024
+
+struct pending {
+	unsigned int ms;
+	Uint8 key;
+	int vel;
+};
+
+static struct pending pending[PENDING_LEN];
+static int pending_len;
+static int pending_bykey[128];
+static int notes_merged, notes_dropped;
+
+/* the time of the last note of each pitch that was flushed, so the merge
+ * window reaches back across frames */
+static unsigned int flushed_ms[128];
+static bool flushed[128];
+
+static int samplerate = 44100;
+
+#ifdef SOUND
+fluid_settings_t *fsettings;
+fluid_synth_t *fsynth;
+fluid_audio_driver_t *fadriver;
+
+/* set once a note has started with the soundfont loaded, see sfont_load() */
+static SDL_atomic_t sounded;
+static void synth_swap(void);
+static void startup_poll(void);
+
+/* maps the simulation clock onto the audio clock, established by the first
+ * note and re-established whenever the two drift too far apart */
+static Uint64 frames;
+static Sint64 skew;
+static bool synced;
+#endif
+
+static bool
+noteq_push(unsigned int ms, int key, int vel)
+{
+	int head = SDL_AtomicGet(&noteq_head);
+	int tail = SDL_AtomicGet(&noteq_tail);
+	if (head - tail >= NOTEQ_LEN) {
+		SDL_AtomicAdd(&noteq_overflows, 1);
+		return false;
+	}
+
+	struct note *n = &noteq[head & (NOTEQ_LEN - 1)];
+	n->time = (Uint64)ms * samplerate / 1000;
+	n->key = key;
+	n->vel = vel;
+	SDL_AtomicSet(&noteq_head, head + 1);
+	return true;
+}
+
+void
+audio_note(unsigned int ms, int key, int vel)
+{
+	/* pending_bykey holds index + 1 of the latest note of each pitch */
+	int i = pending_bykey[key] - 1;
+	if (i >= 0 && ms - pending[i].ms < COALESCE_MS) {
+		pending[i].vel += vel;
+		notes_merged++;
+		return;
+	}
+	if (i < 0 && flushed[key] && ms - flushed_ms[key] < COALESCE_MS) {
+		/* its twin is already queued, too late to make it louder */
+		notes_merged++;
+		return;
+	}
+
+	if (pending_len == PENDING_LEN) {
+		notes_dropped++;
+		return;
+	}
+
+	pending[pending_len].ms = ms;
+	pending[pending_len].key = key;
+	pending[pending_len].vel = vel;
+	pending_bykey[key] = ++pending_len;
+}
+
+static int
+louder(const void *a, const void *b)
+{
+	const struct pending *x = a, *y = b;
+	return y->vel - x->vel;
+}
+
+static int
+earlier(const void *a, const void *b)
+{
+	const struct pending *x = a, *y = b;
+	return (int)(x->ms - y->ms);
+}
+
+void
+audio_flush(void)
+{
+	for (int i = 0; i < pending_len; i++)
+		pending_bykey[pending[i].key] = 0;
+
+	if (pending_len > VOICE_BUDGET) {
+		/* keep the loudest, then restore time order for the queue */
+		qsort(pending, pending_len, sizeof(*pending), louder);
+		notes_dropped += pending_len - VOICE_BUDGET;
+		pending_len = VOICE_BUDGET;
+		qsort(pending, pending_len, sizeof(*pending), earlier);
+	}
+
+	for (int i = 0; i < pending_len; i++) {
+		if (!noteq_push(pending[i].ms, pending[i].key, MIN(pending[i].vel, 127)))
+			continue;
+		flushed_ms[pending[i].key] = pending[i].ms;
+		flushed[pending[i].key] = true;
+	}
+	pending_len = 0;
+
+#ifdef SOUND
+	startup_poll();
+#endif
+}
+
+void
+audio_get_stats(struct audio_stats *stats)
+{
+	stats->overflows = SDL_AtomicGet(&noteq_overflows);
+	stats->merged = notes_merged;
+	stats->dropped = notes_dropped;
+}
+
+#ifdef SOUND
+static struct note *
+noteq_peek(void)
+{
+	int tail = SDL_AtomicGet(&noteq_tail);
+	if (tail == SDL_AtomicGet(&noteq_head))
+		return NULL;
+	return &noteq[tail & (NOTEQ_LEN - 1)];
+}
+
+static void
+noteq_pop(void)
+{
+	SDL_AtomicAdd(&noteq_tail, 1);
+}
+
+typedef void (*render_fn)(int from, int to, void *data);
+
+/* starts every queued note falling before base + len at its offset from
+ * base, rendering the audio between notes with fn */
+static void
+drain(Sint64 base, int len, render_fn fn, void *data)
+{
+	int done = 0;
+	struct note *n;
+
+	while ((n = noteq_peek())) {
+		Sint64 at = (Sint64)n->time - base;
+		if (at >= len)
+			break;
+		if (at > done) {
+			fn(done, at, data);
+			done = at;
+		}
+
+		if (fluid_synth_noteon(fsynth, 0, n->key, n->vel) == FLUID_FAILED)
+			fluid_synth_noteoff(fsynth, 0, n->key);
+		else if (!SDL_AtomicGet(&sounded))
+			SDL_AtomicSet(&sounded, 1);
+		noteq_pop();
+	}
+
+	fn(done, len, data);
+}
+
+#ifndef WORKLET
+struct buffers {
+	int nfx, nout;
+	float **fx, **out;
+};
+
+static void
+render_buffers(int from, int to, void *data)
+{
+	struct buffers *b = data;
+	float *o[b->nout ? b->nout : 1], *f[b->nfx ? b->nfx : 1];
+	for (int i = 0; i < b->nout; i++)
+		o[i] = b->out[i] + from;
+	for (int i = 0; i < b->nfx; i++)
+		f[i] = b->fx[i] + from;
+	fluid_synth_process(fsynth, to - from, b->nfx, f, b->nout, o);
+}
+#endif
+
+/* runs on the audio thread: drains the queue, starting each note at its
+ * exact sample within the buffer. notes are played a frame and one buffer
+ * late, so that a note stamped anywhere within a frame lands at its own
+ * offset, although the frame is only flushed once it has ended */
+static void
+play(int len, render_fn fn, void *data)
+{
+	struct note *n = noteq_peek();
+	Sint64 lead = (Sint64)AUDIO_FRAME * samplerate / 1000;
+
+	synth_swap();
+
+	if (n) {
+		Sint64 at = (Sint64)n->time - skew - lead + len - (Sint64)frames;
+		if (!synced || at < -4*len || at > 8*len) {
+			skew = (Sint64)n->time - lead - (Sint64)frames;
+			synced = true;
+		}
+	}
+
+	drain(skew - len + (Sint64)frames, len, fn, data);
+	frames += len;
+}
+
+#ifndef WORKLET
+static int
+audio_process(void *data, int len, int nfx, float **fx, int nout, float **out)
+{
+	struct buffers b = { nfx, nout, fx, out };
+	play(len, render_buffers, &b);
+	return FLUID_OK;
+}
+#endif
+
+#ifdef WORKLET
+/* in the web build the synth can instead run inside an AudioWorklet, on the
+ * browser's audio rendering thread, so slow frames don't starve it. it reads
+ * the same note queue, which lives in the shared wasm memory */
+#define QUANTUM 128
+
+static Uint8 worklet_stack[16384] __attribute__((aligned(16)));
+static EMSCRIPTEN_WEBAUDIO_T worklet_ctx;
+
+static void
+render_planar(int from, int to, void *data)
+{
+	float *out = data;
+	fluid_synth_write_float(fsynth, to - from, out, from, 1, out + QUANTUM, from, 1);
+}
+
+static EM_BOOL
+worklet_process(int nin, const AudioSampleFrame *in, int nout, AudioSampleFrame *out,
+                int nparams, const AudioParamFrame *params, void *data)
+{
+	play(QUANTUM, render_planar, out[0].data);
+	return EM_TRUE;
+}
+
+static void
+worklet_created(EMSCRIPTEN_WEBAUDIO_T ctx, EM_BOOL ok, void *data)
+{
+	if (!ok) {
+		SDL_Log("Unable to create audio worklet processor");
+		return;
+	}
+
+	int channels[1] = { 2 };
+	EmscriptenAudioWorkletNodeCreateOptions opts = {
+		.numberOfInputs = 0,
+		.numberOfOutputs = 1,
+		.outputChannelCounts = channels,
+	};
+	EMSCRIPTEN_AUDIO_WORKLET_NODE_T node = emscripten_create_wasm_audio_worklet_node(ctx, "soundpong", &opts, worklet_process, NULL);
+	emscripten_audio_node_connect(node, ctx, 0, 0);
+}
+
+static void
+worklet_started(EMSCRIPTEN_WEBAUDIO_T ctx, EM_BOOL ok, void *data)
+{
+	if (!ok) {
+		SDL_Log("Unable to start audio worklet");
+		return;
+	}
+
+	WebAudioWorkletProcessorCreateOptions opts = { .name = "soundpong" };
+	emscripten_create_wasm_audio_worklet_processor_async(ctx, &opts, worklet_created, NULL);
+}
+
+static int
+worklet_init(void)
+{
+	EmscriptenWebAudioCreateAttributes attrs = {
+		.latencyHint = "interactive",
+		.sampleRate = samplerate,
+	};
+
+	worklet_ctx = emscripten_create_audio_context(&attrs);
+	if (!worklet_ctx) {
+		SDL_Log("Unable to create audio context");
+		return -1;
+	}
+	emscripten_start_wasm_audio_worklet_thread_async(worklet_ctx, worklet_stack, sizeof(worklet_stack), worklet_started, NULL);
+	return 0;
+}
+#endif
+
+static int
+settings_new(void)
+{
+	double rate;
+
+	fsettings = new_fluid_settings();
+	if (!fsettings) {
+		SDL_Log("Unable to create fluid settings");
+		return -1;
+	}
+
+#ifdef WORKLET
+	/* only the worklet touches the synth once it is running */
+	fluid_settings_setint(fsettings, "synth.threadsafe-api", 0);
+#endif
+	if (fluid_settings_getnum(fsettings, "synth.sample-rate", &rate) == FLUID_OK)
+		samplerate = rate;
+	return 0;
+}
+
+/* a new synth with the soundfont loaded and tuned, or NULL */
+static fluid_synth_t *
+synth_load(const char *sfpath)
+{
+	int sfid;
+
+	fluid_synth_t *synth = new_fluid_synth(fsettings);
+	if (!synth) {
+		SDL_Log("Unable to create fluid synth");
+		goto err1;
+	}
+
+	if ((sfid = fluid_synth_sfload(synth, sfpath, true)) == FLUID_FAILED) {
+		SDL_Log("Unable to load soundfont %s", sfpath);
+		goto err2;
+	}
+
+	fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, sfid);
+	if (sfont == NULL) {
+		SDL_Log("coudn't load sfont by id");
+		goto err2;
+	}
+
+	fluid_sfont_iteration_start(sfont);
+	fluid_preset_t *fpreset = fluid_sfont_iteration_next(sfont);
+	int bank = fluid_preset_get_banknum(fpreset);
+	int prog = fluid_preset_get_num(fpreset);
+	fluid_synth_activate_tuning(synth, 0, bank, prog, true);
+	return synth;
+
+err2:
+	delete_fluid_synth(synth);
+err1:
+	return NULL;
+}
+
+static int
+synth_new(const char *sfpath)
+{
+	if (settings_new() < 0)
+		return -1;
+
+	fsynth = synth_load(sfpath);
+	if (!fsynth) {
+		delete_fluid_settings(fsettings);
+		return -1;
+	}
+	return 0;
+}
+
+static void
+synth_delete(void)
+{
+	delete_fluid_synth(fsynth);
+	delete_fluid_settings(fsettings);
+}
+
+/* the game doesn't wait for the soundfont: it starts with an empty synth,
+ * which is silent, while the soundfont loads in the background. the loaded
+ * synth is handed to the audio thread, which swaps it in between buffers
+ * and hands the empty one back to be freed */
+static const char *sfont_path;
+static void *nextsynth, *oldsynth;
+static SDL_Thread *loader;
+static SDL_atomic_t loaded_at;
+static bool lazy, reported_load, reported_sound;
+
+static int
+sfont_load(void *data)
+{
+	fluid_synth_t *synth = synth_load(sfont_path);
+	if (synth == NULL) {
+		SDL_Log("Playing without sound");
+		return -1;
+	}
+
+	SDL_AtomicSet(&loaded_at, SDL_GetTicks());
+	SDL_AtomicSetPtr(&nextsynth, synth);
+	return 0;
+}
+
+static void
+sfont_fetched(const char *path)
+{
+	/* without threads it is loaded right here, the game is running by now */
+	loader = SDL_CreateThread(sfont_load, "soundfont", NULL);
+	if (loader == NULL)
+		sfont_load(NULL);
+}
+
+#ifdef EMSCRIPTEN
+/* the web builds don't preload the soundfont, so a page served without
+ * assets/ next to it would otherwise just be silent */
+static void
+sfont_failed(const char *path)
+{
+	char msg[512];
+
+	snprintf(msg, sizeof(msg), "Unable to fetch soundfont %s, playing without sound. "
+	         "The assets directory must be served next to the page.", path);
+	SDL_Log("%s", msg);
+	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "soundpong", msg, NULL);
+}
+
+/* fetch the soundfont into the in-memory filesystem, at the path it would
+ * have been preloaded to */
+static void
+sfont_fetch(const char *path)
+{
+	char dir[256];
+	const char *slash = strrchr(path, '/');
+	if (slash && slash - path < sizeof(dir)) {
+		memcpy(dir, path, slash - path);
+		dir[slash - path] = '\0';
+		mkdir(dir, 0777);
+	}
+	emscripten_async_wget(path, path, sfont_fetched, sfont_failed);
+}
+#endif
+
+/* runs on the audio thread, before rendering each buffer */
+static void
+synth_swap(void)
+{
+	if (!SDL_AtomicGetPtr(&nextsynth))
+		return;
+	SDL_AtomicSetPtr(&oldsynth, fsynth);
+	fsynth = SDL_AtomicSetPtr(&nextsynth, NULL);
+}
+
+/* frees the synth the audio thread swapped out, and reports how long the
+ * soundfont and the first note took */
+static void
+startup_poll(void)
+{
+	void *old;
+
+	if (!lazy)
+		return;
+	if (SDL_AtomicGetPtr(&oldsynth) && (old = SDL_AtomicSetPtr(&oldsynth, NULL)))
+		delete_fluid_synth(old);
+
+	if (!reported_load && SDL_AtomicGet(&loaded_at)) {
+		SDL_Log("startup: soundfont ready after %d ms", SDL_AtomicGet(&loaded_at));
+		reported_load = true;
+	}
+	if (!reported_sound && SDL_AtomicGet(&sounded)) {
+		SDL_Log("startup: first sound after %u ms", SDL_GetTicks());
+		reported_sound = true;
+	}
+}
+#endif
+
+static void
+log_stats(void)
+{
+	struct audio_stats stats;
+	audio_get_stats(&stats);
+	SDL_Log("audio: %d notes merged, %d over budget, %d lost to a full queue",
+	        stats.merged, stats.dropped, stats.overflows);
+}
+
+int
+audio_init(const char *sfpath)
+{
+#ifdef SOUND
+	if (settings_new() < 0)
+		return -1;
+
+	fsynth = new_fluid_synth(fsettings);
+	if (!fsynth) {
+		SDL_Log("Unable to create fluid synth");
+		delete_fluid_settings(fsettings);
+		return -1;
+	}
+
+#ifdef WORKLET
+	if (worklet_init() < 0)
+		goto err;
+#else
+	fluid_settings_setstr(fsettings, "audio.driver", "sdl2");
+	fadriver = new_fluid_audio_driver2(fsettings, audio_process, NULL);
+	if (!fadriver) {
+		SDL_Log("Unable to create fluid synth driver");
+		goto err;
+	}
+#endif
+
+	lazy = true;
+	sfont_path = sfpath;
+#ifdef EMSCRIPTEN
+	sfont_fetch(sfpath);
+#else
+	sfont_fetched(sfpath);
+#endif
+	return 0;
+
+err:
+	synth_delete();
+	return -1;
+#else
+	return 0;
+#endif
+}
+
+void
+audio_quit(void)
+{
+#ifdef SOUND
+	void *synth;
+
+	if (fadriver)
+		delete_fluid_audio_driver(fadriver);
+	if (loader)
+		SDL_WaitThread(loader, NULL);
+	if ((synth = SDL_AtomicSetPtr(&nextsynth, NULL)))
+		delete_fluid_synth(synth);
+	if ((synth = SDL_AtomicSetPtr(&oldsynth, NULL)))
+		delete_fluid_synth(synth);
+	synth_delete();
+#endif
+	log_stats();
+}
+
+/* browsers keep audio suspended until the page has seen a user gesture */
+void
+audio_resume(void)
+{
+#ifdef WORKLET
+	if (worklet_ctx && emscripten_audio_context_state(worklet_ctx) != AUDIO_CONTEXT_STATE_RUNNING)
+		emscripten_resume_audio_context_sync(worklet_ctx);
+#endif
+}
+
+#ifdef SOUND
+static FILE *wav;
+static Uint32 wav_frames;
+static float *wav_buf;
+static int wav_buflen;
+
+static void
+put_le(Uint32 v, int size)
+{
+	for (int i = 0; i < size; i++)
+		fputc((v >> (8*i)) & 0xFF, wav);
+}
+
+/* 32-bit float stereo; the sizes are patched in when the file is closed.
+ * a format other than PCM has the extended fmt chunk and a fact chunk */
+static void
+wav_header(Uint32 frames)
+{
+	Uint32 datalen = frames * 2 * sizeof(float);
+
+	fputs("RIFF", wav);
+	put_le(4 + (8 + 18) + (8 + 4) + (8 + datalen), 4);
+	fputs("WAVEfmt ", wav);
+	put_le(18, 4);
+	put_le(3, 2); /* IEEE float */
+	put_le(2, 2);
+	put_le(samplerate, 4);
+	put_le(samplerate * 2 * sizeof(float), 4);
+	put_le(2 * sizeof(float), 2);
+	put_le(32, 2);
+	put_le(0, 2); /* cbSize */
+	fputs("fact", wav);
+	put_le(4, 4);
+	put_le(frames, 4);
+	fputs("data", wav);
+	put_le(datalen, 4);
+}
+
+static void
+render_wav(int from, int to, void *data)
+{
+	fluid_synth_write_float(fsynth, to - from, wav_buf, 2*from, 2, wav_buf, 2*from + 1, 2);
+}
+#endif
+
+int
+audio_offline_open(const char *sfpath, const char *wavpath)
+{
+#ifdef SOUND
+	if (synth_new(sfpath) < 0)
+		return -1;
+
+	wav = fopen(wavpath, "wb");
+	if (wav == NULL) {
+		SDL_Log("Unable to open %s", wavpath);
+		synth_delete();
+		return -1;
+	}
+	wav_frames = 0;
+	wav_header(0);
+	return 0;
+#else
+	SDL_Log("Built without sound, nothing to render");
+	return -1;
+#endif
+}
+
+/* synthesize exactly as many frames as the simulation has advanced, with
+ * every note starting at the sample its timestamp maps to */
+int
+audio_offline_advance(unsigned int ms)
+{
+#ifdef SOUND
+	Uint32 target = (Uint64)ms * samplerate / 1000;
+	int len = target - wav_frames;
+	if (len <= 0)
+		return 0;
+
+	if (len > wav_buflen) {
+		float *buf = realloc(wav_buf, 2 * len * sizeof(*wav_buf));
+		if (buf == NULL) {
+			SDL_Log("Out of memory rendering audio");
+			return -1;
+		}
+		wav_buf = buf;
+		wav_buflen = len;
+	}
+
+	drain(wav_frames, len, render_wav, NULL);
+	fwrite(wav_buf, sizeof(*wav_buf), 2 * len, wav);
+	wav_frames = target;
+#endif
+	return 0;
+}
+
+void
+audio_offline_close(void)
+{
+#ifdef SOUND
+	rewind(wav);
+	wav_header(wav_frames);
+	fclose(wav);
+	free(wav_buf);
+	wav_buf = NULL;
+	wav_buflen = 0;
+	synth_delete();
+#endif
+	log_stats();
+}
@@ -0,0 +1,52 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdbool.h>
+
+/* built with TRIMMED, the game loads the soundfont cut down by sftrim */
+#ifdef TRIMMED
+#define SOUNDFONT "assets/trimmed.sf2"
+#else
+#define SOUNDFONT "assets/Xylophone-MediumMallets-20200706.sf2"
+#endif
+
+/* the keys and velocity of the notes the game plays; sftrim keeps only the
+ * parts of the soundfont these reach. merged notes are only ever louder */
+#define LOWEST 45
+#define HIGHEST 100
+#define VELOCITY 50
+
+/* notes are collected for a frame of this many milliseconds of simulation
+ * time, and then flushed together. the simulation calls audio_flush() on this
+ * cadence in every mode, however often it is advanced */
+#define AUDIO_FRAME 16
+/* at most this many notes are started per frame */
+#define VOICE_BUDGET 16
+/* a note closer than this to the last one of the same pitch is merged into
+ * it, or dropped if that one was already flushed in an earlier frame */
+#define COALESCE_MS 30
+
+struct audio_stats {
+	int overflows; /* notes lost to a full queue */
+	int merged;    /* notes folded into another of the same pitch */
+	int dropped;   /* notes over the voice budget */
+};
+
+int audio_init(const char *sfpath);
+void audio_quit(void);
+void audio_resume(void);
+
+/* collect a note at the given simulation time in milliseconds. notes are held
+ * until audio_flush(), which merges and budgets them and then queues them for
+ * the audio thread. never blocks */
+void audio_note(unsigned int ms, int key, int vel);
+void audio_flush(void);
+void audio_get_stats(struct audio_stats *stats);
+
+/* offline rendering: no audio driver, the caller advances the audio to the
+ * simulation time after each step and it is written to a wav file */
+int audio_offline_open(const char *sfpath, const char *wavpath);
+int audio_offline_advance(unsigned int ms);
+void audio_offline_close(void);
+
+#endif
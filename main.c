@@ -1,7 +1,3 @@
-#ifdef SOUND
-#include <fluidsynth.h>
-#endif
-
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
 EM_JS(int, canvas_get_width, (), {
@@ -16,40 +12,75 @@ EM_JS(int, canvas_get_height, (), {
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include "SDL2_gfxPrimitives.h"
+#include "audio.h"
 #include <stdio.h>
 
 #define BALL_RADIUS 11
 #define DROPRATE 2000
+#define DROPPER_RADIUS (BALL_RADIUS + 5)
 #define MINLENGTH 20
-
-#define LOWEST 45
-#define HIGHEST 100
+#define STEP 5
+#define MAXLAG 250
 
 const float rate = .01;
 const float G = 1;
 
 struct SDL_Rect screenrect = { 0, 0, 500, 1000 };
 
+/* the simulation runs in world coordinates, and balls leaving the world are
+ * removed. it is the size of the initial window unless it was given on the
+ * command line, and doesn't change with the window */
+struct SDL_Rect world = { 0, 0, 500, 1000 };
+bool worldfixed;
+
+/* the window shows the world from the camera: x and y are the world point at
+ * the top left corner of the window, and zoom is window pixels per world unit */
+struct camera {
+	float x, y;
+	float zoom;
+} cam = { 0, 0, 1 };
+
+#define MINZOOM 0.1
+#define MAXZOOM 10
+
+/* n window pixels as a world distance, for what should feel the same to the
+ * mouse at any zoom */
+#define SCREENDIST(n) ((int)ceilf((n) / cam.zoom))
+#define PICKRADIUS 5
+
 struct SDL_MouseMotionEvent mousestate;
 SDL_Renderer *ren;
 bool dropball;
+unsigned int then, now;
+unsigned int simtime;
 
-#ifdef SOUND
-fluid_synth_t *fsynth;
-#endif
+struct dropper {
+	SDL_Point pos;
+	float vx, vy;
+	int pitch;
+	unsigned int rate;
+	unsigned int due;
+	int heapidx;
+};
 
-SDL_Point dropper = { .x = 100, .y = 100 };
-SDL_Point old_dropper;
+/* droppers are kept in an array, and scheduled through a min-heap of indices
+ * ordered by due time, so only droppers which are due are touched each frame */
+struct dropper *droppers;
+int droppers_len, droppers_cap;
+int *dropheap;
+int selected_dropper = -1;
 
 struct ball {
 	float x, y;
 	float vx, vy;
-	struct ball *next;
-	struct ball *prev;
+	int pitch;
 };
 
-struct ball *balls_first;
-struct ball *balls_last;
+/* balls are kept contiguous, and removed in bulk by balls_cull */
+struct ball *balls;
+int balls_len, balls_cap;
+
+bool ballcollide;
 
 struct line {
 	SDL_Point start;
@@ -64,6 +95,9 @@ struct line *selected_line;
 struct line *lines_first;
 struct line *lines_last;
 
+/* counts changes to droppers, lines and curves */
+unsigned int edits;
+
 bool ismousedown;
 SDL_Point mousedown;
 SDL_Point mousepos;
@@ -103,13 +137,11 @@ ball_intersects_line(struct ball *ball, struct line *line)
 #define DEG(x) (180*((x)/M_PI))
 
 void
-play_vec(float vx, float vy)
+play_vec(float vx, float vy, int pitch)
 {
-	int val = sqrt(vx*vx + vy*vy) / 2 + LOWEST;
-#ifdef SOUND
-	if (fluid_synth_noteon(fsynth, 0, val, 50) == FLUID_FAILED)
-	fluid_synth_noteoff(fsynth, 0, val);
-#endif
+	int val = sqrt(vx*vx + vy*vy) / 2 + LOWEST + pitch;
+	val = MAX(LOWEST, MIN(val, HIGHEST));
+	audio_note(simtime, val, VELOCITY);
 }
 
 bool
@@ -120,7 +152,7 @@ ball_bounce(struct ball *ball, struct line *line)
 	if (i.x < 0 && i.y < 0)
 		return false;
 
-	play_vec(vx, vy);
+	play_vec(vx, vy, ball->pitch);
 
 	// if we intersect and endpoint, just bounce in the opposite direction
 	if ((i.x == line->start.x && i.y == line->start.y) || (i.x == line->end.x && i.y == line->end.y)) {
@@ -157,19 +189,264 @@ xcalloc(int size)
 }
 
 void
-ball_add(int x, int y)
+ball_add(float x, float y, float vx, float vy, int pitch)
 {
-	if (!balls_last) {
-		balls_first = xcalloc(sizeof(*balls_first));
-		balls_first->x = x;
-		balls_first->y = y;
-		balls_last = balls_first;
-	} else {
-		balls_last->next = xcalloc(sizeof(*balls_first));
-		balls_last->next->prev = balls_last;
-		balls_last = balls_last->next;
-		balls_last->x = x;
-		balls_last->y = y;
+	if (balls_len == balls_cap) {
+		balls_cap = balls_cap ? balls_cap * 2 : 256;
+		balls = realloc(balls, balls_cap * sizeof(*balls));
+		if (balls == NULL)
+			SDL_Quit();
+	}
+	balls[balls_len++] = (struct ball){ x, y, vx, vy, pitch };
+}
+
+/* remove every ball which has left the world, in one pass which keeps the
+ * rest in order. each ball is copied down unconditionally, and only counted
+ * if it is kept */
+void
+balls_cull(void)
+{
+	float x0 = world.x - BALL_RADIUS, x1 = world.x + world.w + BALL_RADIUS;
+	float y0 = world.y - BALL_RADIUS, y1 = world.y + world.h + BALL_RADIUS;
+	int n = 0;
+
+	for (int i = 0; i < balls_len; i++) {
+		struct ball *ball = &balls[i];
+		balls[n] = *ball;
+		n += (ball->x > x0) & (ball->x < x1) & (ball->y > y0) & (ball->y < y1);
+	}
+	balls_len = n;
+}
+
+/* line endpoints and droppers are indexed by a spatial hash, kept up to date
+ * as they are edited, so hovering and picking don't scan the scene */
+struct pick {
+	int x, y;
+	struct line *line; /* NULL for a dropper */
+	int which;         /* 0 for the start of the line and 1 for its end, or the dropper's index */
+};
+
+struct pickbucket {
+	struct pick *items;
+	int len, cap;
+};
+
+static struct {
+	struct pickbucket *buckets;
+	int nbuckets, len;
+} pk;
+
+#define PICK_CELL (2*DROPPER_RADIUS)
+#define PICK_HASH(x, y) ((((unsigned)(x) * 73856093u) ^ ((unsigned)(y) * 19349663u)) & (pk.nbuckets - 1))
+
+static int
+pick_cell(int v)
+{
+	return v >= 0 ? v / PICK_CELL : -((-v + PICK_CELL - 1) / PICK_CELL);
+}
+
+static struct pickbucket *
+pick_bucket(int x, int y)
+{
+	return &pk.buckets[PICK_HASH(pick_cell(x), pick_cell(y))];
+}
+
+static void
+pick_insert(struct pick p)
+{
+	struct pickbucket *b = pick_bucket(p.x, p.y);
+	if (b->len == b->cap) {
+		b->cap = b->cap ? b->cap * 2 : 4;
+		b->items = realloc(b->items, b->cap * sizeof(*b->items));
+		if (b->items == NULL)
+			SDL_Quit();
+	}
+	b->items[b->len++] = p;
+}
+
+static void
+pick_add(int x, int y, struct line *line, int which)
+{
+	/* keep the buckets short by doubling them as the scene grows */
+	if (pk.len >= 2 * pk.nbuckets) {
+		struct pickbucket *old = pk.buckets;
+		int n = pk.nbuckets;
+
+		pk.nbuckets = n ? n * 2 : 256;
+		pk.buckets = calloc(pk.nbuckets, sizeof(*pk.buckets));
+		if (pk.buckets == NULL)
+			SDL_Quit();
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < old[i].len; j++)
+				pick_insert(old[i].items[j]);
+			free(old[i].items);
+		}
+		free(old);
+	}
+
+	pick_insert((struct pick){x, y, line, which});
+	pk.len++;
+}
+
+static void
+pick_del(int x, int y, struct line *line, int which)
+{
+	if (pk.nbuckets == 0)
+		return;
+
+	struct pickbucket *b = pick_bucket(x, y);
+	for (int i = 0; i < b->len; i++) {
+		if (b->items[i].line == line && b->items[i].which == which) {
+			b->items[i] = b->items[--b->len];
+			pk.len--;
+			return;
+		}
+	}
+}
+
+/* the closest endpoint, or dropper, within r of (x, y) */
+static struct pick *
+pick_find(int x, int y, int r, bool dropper)
+{
+	struct pick *best = NULL;
+	int bestd2 = r*r;
+
+	if (pk.nbuckets == 0)
+		return NULL;
+
+	for (int cy = pick_cell(y - r); cy <= pick_cell(y + r); cy++) {
+		for (int cx = pick_cell(x - r); cx <= pick_cell(x + r); cx++) {
+			struct pickbucket *b = &pk.buckets[PICK_HASH(cx, cy)];
+			for (int i = 0; i < b->len; i++) {
+				struct pick *p = &b->items[i];
+				if ((p->line == NULL) != dropper)
+					continue;
+				int d2 = (p->x - x)*(p->x - x) + (p->y - y)*(p->y - y);
+				if (d2 <= bestd2) {
+					bestd2 = d2;
+					best = p;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+static SDL_Point *
+pick_point(struct pick *p)
+{
+	if (p->line == NULL)
+		return &droppers[p->which].pos;
+	return p->which ? &p->line->end : &p->line->start;
+}
+
+#define DUE_BEFORE(a, b) ((int)(droppers[(a)].due - droppers[(b)].due) < 0)
+
+static void
+dropheap_swap(int i, int j)
+{
+	int tmp = dropheap[i];
+	dropheap[i] = dropheap[j];
+	dropheap[j] = tmp;
+	droppers[dropheap[i]].heapidx = i;
+	droppers[dropheap[j]].heapidx = j;
+}
+
+static void
+dropheap_up(int i)
+{
+	while (i > 0 && DUE_BEFORE(dropheap[i], dropheap[(i - 1) / 2])) {
+		dropheap_swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void
+dropheap_down(int i)
+{
+	for (;;) {
+		int l = 2*i + 1, r = 2*i + 2, min = i;
+		if (l < droppers_len && DUE_BEFORE(dropheap[l], dropheap[min]))
+			min = l;
+		if (r < droppers_len && DUE_BEFORE(dropheap[r], dropheap[min]))
+			min = r;
+		if (min == i)
+			return;
+		dropheap_swap(i, min);
+		i = min;
+	}
+}
+
+void
+dropper_add(int x, int y, unsigned int rate, float vx, float vy, int pitch, unsigned int now)
+{
+	SDL_assert(rate > 0);
+	if (droppers_len == droppers_cap) {
+		droppers_cap = droppers_cap ? droppers_cap * 2 : 16;
+		droppers = realloc(droppers, droppers_cap * sizeof(*droppers));
+		dropheap = realloc(dropheap, droppers_cap * sizeof(*dropheap));
+		if (droppers == NULL || dropheap == NULL)
+			SDL_Quit();
+	}
+
+	struct dropper *d = &droppers[droppers_len];
+	*d = (struct dropper){
+		.pos = { x, y },
+		.vx = vx, .vy = vy,
+		.pitch = pitch,
+		.rate = rate,
+		.due = now + rate,
+		.heapidx = droppers_len,
+	};
+	dropheap[droppers_len] = droppers_len;
+	pick_add(x, y, NULL, droppers_len);
+	droppers_len++;
+	edits++;
+	dropheap_up(d->heapidx);
+}
+
+void
+dropper_del(int idx)
+{
+	int last = droppers_len - 1;
+	int hole = droppers[idx].heapidx;
+
+	pick_del(droppers[idx].pos.x, droppers[idx].pos.y, NULL, idx);
+
+	/* remove from the heap by moving the last heap entry into the hole */
+	dropheap_swap(hole, last);
+	droppers_len--;
+	if (hole < droppers_len) {
+		dropheap_down(hole);
+		dropheap_up(hole);
+	}
+
+	/* then keep the array dense by moving the last dropper into idx */
+	if (idx != last) {
+		droppers[idx] = droppers[last];
+		dropheap[droppers[idx].heapidx] = idx;
+		pick_del(droppers[idx].pos.x, droppers[idx].pos.y, NULL, last);
+		pick_add(droppers[idx].pos.x, droppers[idx].pos.y, NULL, idx);
+	}
+	edits++;
+}
+
+int
+dropper_at(int x, int y)
+{
+	struct pick *p = pick_find(x, y, DROPPER_RADIUS, true);
+	return p ? p->which : -1;
+}
+
+/* drop a ball from every dropper which is due, and reschedule it */
+void
+droppers_run(unsigned int now)
+{
+	while (droppers_len && (int)(now - droppers[dropheap[0]].due) >= 0) {
+		struct dropper *d = &droppers[dropheap[0]];
+		ball_add(d->pos.x, d->pos.y, d->vx, d->vy, d->pitch);
+		d->due = now + d->rate;
+		dropheap_down(0);
 	}
 }
 
@@ -192,11 +469,17 @@ line_add(int x1, int y1, int x2, int y2)
 		lines_last->end.x = x2;
 		lines_last->end.y = y2;
 	}
+	pick_add(x1, y1, lines_last, 0);
+	pick_add(x2, y2, lines_last, 1);
+	edits++;
 }
 
 void
 line_del(struct line *line)
 {
+	pick_del(line->start.x, line->start.y, line, 0);
+	pick_del(line->end.x, line->end.y, line, 1);
+
 	if (line == lines_first) {
 		lines_first = lines_first->next;
 	} else {
@@ -209,34 +492,409 @@ line_del(struct line *line)
 		line->next->prev = line->prev;
 	}
 	free(line);
+	edits++;
 }
 
+/* move the selected endpoint or dropper, keeping the index up to date */
 void
-ball_del(struct ball *ball)
+selected_move(int x, int y)
 {
-	if (ball == NULL)
-		return;
-	if (ball->next == NULL && ball->prev == NULL) {
-		balls_first = balls_last = NULL;
-		free(ball);
+	if (selected_line)
+		pick_del(selected->x, selected->y, selected_line, selected == &selected_line->end);
+	else
+		pick_del(selected->x, selected->y, NULL, selected_dropper);
+	selected->x = x;
+	selected->y = y;
+	if (selected_line)
+		pick_add(x, y, selected_line, selected == &selected_line->end);
+	else
+		pick_add(x, y, NULL, selected_dropper);
+	edits++;
+}
+
+/* curved deflectors are cubic beziers, flattened once into polylines which
+ * are what the balls actually bounce off */
+#define CURVE_TOLERANCE 0.5
+#define CURVE_PATH 256
+
+struct curve {
+	double x[4], y[4];
+	double *px, *py;
+	int npts;
+	struct curve *next;
+	struct curve *prev;
+};
+
+struct curve *curves_first;
+struct curve *curves_last;
+
+/* the mouse path of a curve being drawn with shift held */
+SDL_Point curvepath[CURVE_PATH];
+int curvepath_len;
+bool drawingcurve;
+
+/* the flattened segments of all curves, bucketed into a spatial hash which
+ * is only rebuilt when curves change, so a ball only tests nearby segments */
+struct seg {
+	float x1, y1, x2, y2;
+	bool first, last;
+	struct curve *curve;
+};
+
+static struct {
+	struct seg *segs;
+	int nsegs, segcap;
+	int *seg, *cx, *cy;
+	int *order;
+	int *start;
+	int nents, entcap, buckets;
+	bool dirty;
+} sg;
+
+#define SG_CELL 64
+#define SG_HASH(x, y) ((((unsigned)(x) * 73856093u) ^ ((unsigned)(y) * 19349663u)) & (sg.buckets - 1))
+
+static void
+sg_build(void)
+{
+	sg.nsegs = 0;
+	sg.nents = 0;
+	for (struct curve *curve = curves_first; curve != NULL; curve = curve->next) {
+		for (int i = 0; i < curve->npts - 1; i++) {
+			if (sg.nsegs == sg.segcap) {
+				sg.segcap = sg.segcap ? sg.segcap * 2 : 256;
+				sg.segs = realloc(sg.segs, sg.segcap * sizeof(*sg.segs));
+				if (sg.segs == NULL)
+					SDL_Quit();
+			}
+			struct seg *s = &sg.segs[sg.nsegs++];
+			*s = (struct seg){
+				curve->px[i], curve->py[i], curve->px[i + 1], curve->py[i + 1],
+				.first = i == 0, .last = i == curve->npts - 2,
+				.curve = curve,
+			};
+			sg.nents += (floorf(MAX(s->x1, s->x2) / SG_CELL) - floorf(MIN(s->x1, s->x2) / SG_CELL) + 1)
+			          * (floorf(MAX(s->y1, s->y2) / SG_CELL) - floorf(MIN(s->y1, s->y2) / SG_CELL) + 1);
+		}
+	}
+	sg.dirty = false;
+	if (sg.nents == 0)
 		return;
+
+	if (sg.nents > sg.entcap) {
+		while (sg.entcap < sg.nents)
+			sg.entcap = sg.entcap ? sg.entcap * 2 : 1024;
+		sg.buckets = 2 * sg.entcap;
+		sg.seg = realloc(sg.seg, sg.entcap * sizeof(*sg.seg));
+		sg.cx = realloc(sg.cx, sg.entcap * sizeof(*sg.cx));
+		sg.cy = realloc(sg.cy, sg.entcap * sizeof(*sg.cy));
+		sg.order = realloc(sg.order, sg.entcap * sizeof(*sg.order));
+		sg.start = realloc(sg.start, (sg.buckets + 1) * sizeof(*sg.start));
+		if (!sg.seg || !sg.cx || !sg.cy || !sg.order || !sg.start)
+			SDL_Quit();
+	}
+
+	/* one entry per cell each segment's bounding box covers, counting sorted
+	 * by bucket as in the ball broadphase */
+	memset(sg.start, 0, (sg.buckets + 1) * sizeof(*sg.start));
+	int n = 0;
+	for (int i = 0; i < sg.nsegs; i++) {
+		struct seg *s = &sg.segs[i];
+		int cx0 = floorf(MIN(s->x1, s->x2) / SG_CELL), cx1 = floorf(MAX(s->x1, s->x2) / SG_CELL);
+		int cy0 = floorf(MIN(s->y1, s->y2) / SG_CELL), cy1 = floorf(MAX(s->y1, s->y2) / SG_CELL);
+		for (int cy = cy0; cy <= cy1; cy++) {
+			for (int cx = cx0; cx <= cx1; cx++, n++) {
+				sg.seg[n] = i;
+				sg.cx[n] = cx;
+				sg.cy[n] = cy;
+				sg.start[SG_HASH(cx, cy) + 1]++;
+			}
+		}
+	}
+	for (int h = 0; h < sg.buckets; h++)
+		sg.start[h + 1] += sg.start[h];
+	for (int i = 0; i < n; i++)
+		sg.order[sg.start[SG_HASH(sg.cx[i], sg.cy[i])]++] = i;
+	for (int h = sg.buckets; h > 0; h--)
+		sg.start[h] = sg.start[h - 1];
+	sg.start[0] = 0;
+}
+
+/* find the curve segment closest to (x, y) within r, and the closest point on it */
+static struct seg *
+sg_nearest(float x, float y, float r, float *qx, float *qy, bool *end)
+{
+	if (sg.dirty)
+		sg_build();
+	if (sg.nents == 0)
+		return NULL;
+
+	struct seg *best = NULL;
+	float bestd2 = r*r;
+	int cx0 = floorf((x - r) / SG_CELL), cx1 = floorf((x + r) / SG_CELL);
+	int cy0 = floorf((y - r) / SG_CELL), cy1 = floorf((y + r) / SG_CELL);
+	for (int cy = cy0; cy <= cy1; cy++) {
+		for (int cx = cx0; cx <= cx1; cx++) {
+			unsigned int h = SG_HASH(cx, cy);
+			for (int k = sg.start[h]; k < sg.start[h + 1]; k++) {
+				int e = sg.order[k];
+				if (sg.cx[e] != cx || sg.cy[e] != cy)
+					continue;
+				struct seg *s = &sg.segs[sg.seg[e]];
+				float dx = s->x2 - s->x1, dy = s->y2 - s->y1;
+				float l2 = dx*dx + dy*dy;
+				float u = l2 > 0 ? ((x - s->x1)*dx + (y - s->y1)*dy) / l2 : 0;
+				u = MAX(0, MIN(u, 1));
+				float px = s->x1 + u*dx, py = s->y1 + u*dy;
+				float d2 = (x - px)*(x - px) + (y - py)*(y - py);
+				if (d2 <= bestd2) {
+					bestd2 = d2;
+					best = s;
+					*qx = px;
+					*qy = py;
+					*end = (u == 0 && s->first) || (u == 1 && s->last);
+				}
+			}
+		}
 	}
+	return best;
+}
 
-	if (ball == balls_first) {
-		balls_first = balls_first->next;
-		balls_first->prev = NULL;
+void
+curve_add(const double *x, const double *y)
+{
+	struct curve *curve = xcalloc(sizeof(*curve));
+	memcpy(curve->x, x, sizeof(curve->x));
+	memcpy(curve->y, y, sizeof(curve->y));
+	curve->npts = bezierFlatten(x, y, 4, CURVE_TOLERANCE, NULL, NULL, 0);
+	curve->px = xcalloc(2 * curve->npts * sizeof(*curve->px));
+	curve->py = curve->px + curve->npts;
+	bezierFlatten(x, y, 4, CURVE_TOLERANCE, curve->px, curve->py, curve->npts);
+
+	if (!curves_last) {
+		curves_first = curves_last = curve;
 	} else {
-		ball->prev->next = ball->next;
+		curves_last->next = curve;
+		curve->prev = curves_last;
+		curves_last = curve;
 	}
+	sg.dirty = true;
+	edits++;
+}
+
+void
+curve_del(struct curve *curve)
+{
+	if (curve == curves_first)
+		curves_first = curve->next;
+	else
+		curve->prev->next = curve->next;
+
+	if (curve == curves_last)
+		curves_last = curve->prev;
+	else
+		curve->next->prev = curve->prev;
+
+	free(curve->px);
+	free(curve);
+	sg.dirty = true;
+	edits++;
+}
+
+struct curve *
+curve_at(int x, int y)
+{
+	float qx, qy;
+	bool end;
+	struct seg *s = sg_nearest(x, y, 5, &qx, &qy, &end);
+	return s ? s->curve : NULL;
+}
 
-	if (ball == balls_last) {
-		balls_last = balls_last->prev;
-		balls_last->next = NULL;
+/* bounce off the closest point of the nearest curve; like lines, the ends of
+ * a curve send the ball straight back */
+bool
+curve_bounce(struct ball *ball)
+{
+	float qx, qy;
+	bool end;
+	if (!sg_nearest(ball->x, ball->y, BALL_RADIUS, &qx, &qy, &end))
+		return false;
+
+	float nx = ball->x - qx, ny = ball->y - qy;
+	float d = sqrtf(nx*nx + ny*ny);
+	if (d == 0)
+		return false;
+	nx /= d;
+	ny /= d;
+
+	/* only bounce towards the ball's side, so it doesn't stick while leaving */
+	float vn = ball->vx*nx + ball->vy*ny;
+	if (vn >= 0)
+		return false;
+
+	play_vec(ball->vx, ball->vy, ball->pitch);
+	if (end) {
+		ball->vx = -ball->vx;
+		ball->vy = -ball->vy;
 	} else {
-		ball->next->prev = ball->prev;
+		ball->vx -= 2*vn*nx;
+		ball->vy -= 2*vn*ny;
+	}
+	return true;
+}
+
+static void
+curvepath_add(int x, int y)
+{
+	/* keep the path bounded by dropping every other point when it fills up */
+	if (curvepath_len == CURVE_PATH) {
+		for (int i = 1; i < CURVE_PATH / 2; i++)
+			curvepath[i] = curvepath[2*i];
+		curvepath[CURVE_PATH / 2 - 1] = curvepath[CURVE_PATH - 1];
+		curvepath_len = CURVE_PATH / 2;
+	}
+	curvepath[curvepath_len++] = (SDL_Point){x, y};
+}
+
+/* the point at distance dist along the path */
+static void
+curvepath_at(double dist, double *x, double *y)
+{
+	for (int i = 1; i < curvepath_len; i++) {
+		double dx = curvepath[i].x - curvepath[i - 1].x, dy = curvepath[i].y - curvepath[i - 1].y;
+		double len = sqrt(dx*dx + dy*dy);
+		if (len > 0 && dist <= len) {
+			*x = curvepath[i - 1].x + dx * dist / len;
+			*y = curvepath[i - 1].y + dy * dist / len;
+			return;
+		}
+		dist -= len;
+	}
+	*x = curvepath[curvepath_len - 1].x;
+	*y = curvepath[curvepath_len - 1].y;
+}
+
+/* fit a cubic through the ends of the path and the points a third and two
+ * thirds of the way along it */
+void
+curvepath_fit(double *x, double *y)
+{
+	double total = 0, q1x, q1y, q2x, q2y;
+	for (int i = 1; i < curvepath_len; i++) {
+		double dx = curvepath[i].x - curvepath[i - 1].x, dy = curvepath[i].y - curvepath[i - 1].y;
+		total += sqrt(dx*dx + dy*dy);
 	}
+	curvepath_at(total / 3, &q1x, &q1y);
+	curvepath_at(2 * total / 3, &q2x, &q2y);
+
+	x[0] = curvepath[0].x;
+	y[0] = curvepath[0].y;
+	x[3] = curvepath[curvepath_len - 1].x;
+	y[3] = curvepath[curvepath_len - 1].y;
+	x[1] = (-5*x[0] + 18*q1x - 9*q2x + 2*x[3]) / 6;
+	y[1] = (-5*y[0] + 18*q1y - 9*q2y + 2*y[3]) / 6;
+	x[2] = (2*x[0] - 9*q1x + 18*q2x - 5*x[3]) / 6;
+	y[2] = (2*y[0] - 9*q1y + 18*q2y - 5*y[3]) / 6;
+}
+
+/* scratch space for the ball-ball broadphase: balls are bucketed into a
+ * spatial hash of cells the size of a ball, by counting sort */
+static struct {
+	int *cx, *cy;
+	int *order;
+	int *start;
+	int cap, buckets;
+} bp;
+
+#define BP_CELL (2*BALL_RADIUS)
+#define BP_HASH(x, y) ((((unsigned)(x) * 73856093u) ^ ((unsigned)(y) * 19349663u)) & (bp.buckets - 1))
+
+static void
+bp_reserve(int n)
+{
+	if (n <= bp.cap)
+		return;
+	while (bp.cap < n)
+		bp.cap = bp.cap ? bp.cap * 2 : 256;
+	bp.buckets = 2 * bp.cap;
+	bp.cx = realloc(bp.cx, bp.cap * sizeof(*bp.cx));
+	bp.cy = realloc(bp.cy, bp.cap * sizeof(*bp.cy));
+	bp.order = realloc(bp.order, bp.cap * sizeof(*bp.order));
+	bp.start = realloc(bp.start, (bp.buckets + 1) * sizeof(*bp.start));
+	if (!bp.cx || !bp.cy || !bp.order || !bp.start)
+		SDL_Quit();
+}
+
+static void
+ball_collide(struct ball *a, struct ball *b)
+{
+	float dx = b->x - a->x, dy = b->y - a->y;
+	float d2 = dx*dx + dy*dy;
+	if (d2 > 4*BALL_RADIUS*BALL_RADIUS || d2 == 0)
+		return;
+
+	float d = sqrtf(d2);
+	float nx = dx / d, ny = dy / d;
 
-	free(ball);
+	/* separate them so they don't stay stuck together */
+	float push = (2*BALL_RADIUS - d) / 2;
+	a->x -= push*nx;
+	a->y -= push*ny;
+	b->x += push*nx;
+	b->y += push*ny;
+
+	/* equal masses, so an elastic collision swaps the normal components */
+	float vrel = (a->vx - b->vx)*nx + (a->vy - b->vy)*ny;
+	if (vrel <= 0)
+		return;
+
+	a->vx -= vrel*nx;
+	a->vy -= vrel*ny;
+	b->vx += vrel*nx;
+	b->vy += vrel*ny;
+	play_vec(vrel*nx, vrel*ny, a->pitch);
+}
+
+void
+balls_collide(void)
+{
+	int n = balls_len;
+	if (n < 2)
+		return;
+	bp_reserve(n);
+
+	memset(bp.start, 0, (bp.buckets + 1) * sizeof(*bp.start));
+	for (int i = 0; i < n; i++) {
+		bp.cx[i] = floorf(balls[i].x / BP_CELL);
+		bp.cy[i] = floorf(balls[i].y / BP_CELL);
+		bp.start[BP_HASH(bp.cx[i], bp.cy[i]) + 1]++;
+	}
+	for (int h = 0; h < bp.buckets; h++)
+		bp.start[h + 1] += bp.start[h];
+	for (int i = 0; i < n; i++) {
+		unsigned int h = BP_HASH(bp.cx[i], bp.cy[i]);
+		bp.order[bp.start[h]++] = i;
+	}
+	/* the placement pass shifted every start to the next bucket's */
+	for (int h = bp.buckets; h > 0; h--)
+		bp.start[h] = bp.start[h - 1];
+	bp.start[0] = 0;
+
+	for (int i = 0; i < n; i++) {
+		for (int oy = -1; oy <= 1; oy++) {
+			for (int ox = -1; ox <= 1; ox++) {
+				int cx = bp.cx[i] + ox, cy = bp.cy[i] + oy;
+				unsigned int h = BP_HASH(cx, cy);
+				for (int k = bp.start[h]; k < bp.start[h + 1]; k++) {
+					int j = bp.order[k];
+					/* each pair once, and skip other cells sharing the bucket */
+					if (j <= i || bp.cx[j] != cx || bp.cy[j] != cy)
+						continue;
+					ball_collide(&balls[i], &balls[j]);
+				}
+			}
+		}
+	}
 }
 
 void
@@ -250,51 +908,406 @@ ball_update(struct ball *ball, unsigned int delta)
 SDL_Rect result;
 
 bool running;
-unsigned int then, now, delta;
-SDL_Rect ballrect;
-unsigned int lastdrop;
+bool presented;
+const char *scenepath;
+const char *soundfont = SOUNDFONT;
+
+/* a scene file holds one dropper, line or curve per line of text:
+ *	d x y rate vx vy pitch
+ *	l x1 y1 x2 y2
+ *	c x0 y0 x1 y1 x2 y2 x3 y3
+ */
+int
+scene_load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		SDL_Log("Unable to open scene %s", path);
+		return -1;
+	}
+
+	char buf[256];
+	int x1, y1, x2, y2, pitch;
+	unsigned int rate;
+	float vx, vy;
+	double cx[4], cy[4];
+	while (fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, "d %d %d %u %f %f %d", &x1, &y1, &rate, &vx, &vy, &pitch) == 6) {
+			/* a dropper with no period would be due forever */
+			if (rate == 0) {
+				SDL_Log("Dropper with rate 0 in scene %s", path);
+				fclose(f);
+				return -1;
+			}
+			dropper_add(x1, y1, rate, vx, vy, pitch, simtime);
+		} else if (sscanf(buf, "l %d %d %d %d", &x1, &y1, &x2, &y2) == 4)
+			line_add(x1, y1, x2, y2);
+		else if (sscanf(buf, "c %lf %lf %lf %lf %lf %lf %lf %lf", &cx[0], &cy[0], &cx[1], &cy[1], &cx[2], &cy[2], &cx[3], &cy[3]) == 8)
+			curve_add(cx, cy);
+	}
+
+	fclose(f);
+	return 0;
+}
+
+int
+scene_save(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		SDL_Log("Unable to save scene %s", path);
+		return -1;
+	}
+
+	for (int i = 0; i < droppers_len; i++) {
+		struct dropper *d = &droppers[i];
+		fprintf(f, "d %d %d %u %g %g %d\n", d->pos.x, d->pos.y, d->rate, d->vx, d->vy, d->pitch);
+	}
+	for (struct line *line = lines_first; line != NULL; line = line->next)
+		fprintf(f, "l %d %d %d %d\n", line->start.x, line->start.y, line->end.x, line->end.y);
+	for (struct curve *c = curves_first; c != NULL; c = c->next)
+		fprintf(f, "c %g %g %g %g %g %g %g %g\n", c->x[0], c->y[0], c->x[1], c->y[1], c->x[2], c->y[2], c->x[3], c->y[3]);
+
+	fclose(f);
+	return 0;
+}
+
+/* the simulation time up to which notes have been flushed */
+unsigned int flushtime;
 
-#ifdef SOUND
-	fluid_settings_t *fsettings;
-	fluid_audio_driver_t *fadriver;
+/* advance the simulation by one fixed step of STEP milliseconds, flushing
+ * the notes once every AUDIO_FRAME milliseconds */
+void
+step(void)
+{
+	simtime += STEP;
+	droppers_run(simtime);
+
+	if (ballcollide)
+		balls_collide();
+
+	for (int i = 0; i < balls_len; i++) {
+		struct ball *ball = &balls[i];
+		struct line *line;
+		for (line = lines_first; line != NULL; line = line->next) {
+			if (ball_bounce(ball, line)) // returns true if it has bounced, can only bounce off of one line.
+				break;
+		}
+		if (line == NULL)
+			curve_bounce(ball);
+
+		ball_update(ball, STEP);
+	}
+	balls_cull();
+
+	if (simtime - flushtime >= AUDIO_FRAME) {
+		flushtime += AUDIO_FRAME;
+		audio_flush();
+	}
+}
+
+/* the ball snapshot handoff: render() draws balls from a snapshot of their
+ * positions, published after each batch of steps. there are three: the
+ * simulation fills the back one while the main thread draws the front one,
+ * and the third holds the newest finished snapshot. publishing and acquiring
+ * each swap an index with the middle one atomically, so neither side ever
+ * waits for or skips the other. this only matters with SIMTHREAD; rendering
+ * itself always stays on the main thread */
+struct snapshot {
+	SDL_FPoint *balls;
+	int len, cap;
+	unsigned int simtime;
+};
+
+#define SNAP_NEW 4
+
+static struct snapshot snaps[3];
+static int snap_back = 1, snap_front = 0;
+static SDL_atomic_t snap_ready = {2};
+
+static void
+snapshot_publish(void)
+{
+	struct snapshot *s = &snaps[snap_back];
+	s->len = 0;
+	for (int i = 0; i < balls_len; i++) {
+		struct ball *ball = &balls[i];
+		if (s->len == s->cap) {
+			s->cap = s->cap ? s->cap * 2 : 256;
+			s->balls = realloc(s->balls, s->cap * sizeof(*s->balls));
+			if (s->balls == NULL)
+				SDL_Quit();
+		}
+		s->balls[s->len++] = (SDL_FPoint){ball->x, ball->y};
+	}
+	s->simtime = simtime;
+
+	snap_back = SDL_AtomicSet(&snap_ready, snap_back | SNAP_NEW) & ~SNAP_NEW;
+}
+
+/* the returned snapshot stays valid until the next call */
+static struct snapshot *
+snapshot_acquire(void)
+{
+	if (SDL_AtomicGet(&snap_ready) & SNAP_NEW)
+		snap_front = SDL_AtomicSet(&snap_ready, snap_front) & ~SNAP_NEW;
+	return &snaps[snap_front];
+}
+
+/* catch the simulation up with the clock, in fixed steps */
+static void
+advance(void)
+{
+	now = SDL_GetTicks();
+	if (now - then > MAXLAG)
+		then = now - MAXLAG;
+	while (now - then >= STEP) {
+		then += STEP;
+		step();
+	}
+	snapshot_publish();
+}
+
+/* with SIMTHREAD the simulation runs on its own thread, and the main thread
+ * only handles input and renders. edits to the scene are made holding the
+ * world lock, which the simulation holds while it steps */
+#ifdef SIMTHREAD
+static SDL_Thread *simthread;
+static SDL_mutex *worldmtx;
+static SDL_atomic_t simrunning;
+
+static int
+sim_run(void *data)
+{
+	while (SDL_AtomicGet(&simrunning)) {
+		SDL_LockMutex(worldmtx);
+		advance();
+		SDL_UnlockMutex(worldmtx);
+		SDL_Delay(1);
+	}
+	return 0;
+}
+#endif
+
+static void
+world_lock(void)
+{
+#ifdef SIMTHREAD
+	SDL_LockMutex(worldmtx);
+#endif
+}
+
+static void
+world_unlock(void)
+{
+#ifdef SIMTHREAD
+	SDL_UnlockMutex(worldmtx);
+#endif
+}
+
+int
+sim_start(void)
+{
+#ifdef SIMTHREAD
+	worldmtx = SDL_CreateMutex();
+	if (worldmtx == NULL) {
+		SDL_Log("Unable to create world lock: %s", SDL_GetError());
+		return -1;
+	}
+
+	SDL_AtomicSet(&simrunning, 1);
+	simthread = SDL_CreateThread(sim_run, "simulation", NULL);
+	if (simthread == NULL) {
+		SDL_Log("Unable to create simulation thread: %s", SDL_GetError());
+		SDL_DestroyMutex(worldmtx);
+		return -1;
+	}
 #endif
-	int sfid;
+	return 0;
+}
+
 void
-loop()
+sim_stop(void)
+{
+#ifdef SIMTHREAD
+	SDL_AtomicSet(&simrunning, 0);
+	SDL_WaitThread(simthread, NULL);
+	SDL_DestroyMutex(worldmtx);
+#endif
+}
+
+#define EVENT_BATCH 64
+
+/* mouse positions are turned into world coordinates as events are read */
+static void
+event_to_world(SDL_Event *e)
+{
+	switch (e->type) {
+	case SDL_MOUSEMOTION:
+		e->motion.x = floorf(cam.x + e->motion.x / cam.zoom);
+		e->motion.y = floorf(cam.y + e->motion.y / cam.zoom);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		e->button.x = floorf(cam.x + e->button.x / cam.zoom);
+		e->button.y = floorf(cam.y + e->button.y / cam.zoom);
+		break;
+	}
+}
+
+/* zoom by the given factor, keeping the world point under the mouse still */
+static void
+camera_zoom(float factor)
+{
+	int mx, my;
+	SDL_GetMouseState(&mx, &my);
+	float zoom = MIN(MAX(cam.zoom * factor, MINZOOM), MAXZOOM);
+	cam.x += mx / cam.zoom - mx / zoom;
+	cam.y += my / cam.zoom - my / zoom;
+	cam.zoom = zoom;
+}
+
+/* after the camera moves, the mouse is over another world point */
+static void
+mouse_refresh(void)
+{
+	int mx, my;
+	SDL_GetMouseState(&mx, &my);
+	mousepos.x = floorf(cam.x + mx / cam.zoom);
+	mousepos.y = floorf(cam.y + my / cam.zoom);
+}
+
+/* the next event of the frame. the queue is pumped once per frame and read
+ * in batches, rather than pumped for every event as SDL_PollEvent does, and
+ * of a run of motion events only the last is returned, the others only
+ * extending the path of a curve being drawn. this way a high rate mouse or
+ * touch device costs little more per frame than any other */
+static bool
+next_event(SDL_Event *e)
+{
+	static SDL_Event batch[EVENT_BATCH];
+	static int len, pos;
+
+	for (;;) {
+		if (pos == len) {
+			len = SDL_PeepEvents(batch, EVENT_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+			pos = 0;
+			if (len <= 0) {
+				len = 0;
+				return false;
+			}
+		}
+
+		*e = batch[pos++];
+		event_to_world(e);
+		if (e->type == SDL_MOUSEMOTION && pos < len && batch[pos].type == SDL_MOUSEMOTION) {
+			if (drawingcurve)
+				curvepath_add(e->motion.x, e->motion.y);
+			/* panning follows the relative motion, so keep it */
+			batch[pos].motion.xrel += e->motion.xrel;
+			batch[pos].motion.yrel += e->motion.yrel;
+			continue;
+		}
+		return true;
+	}
+}
+
+/* the input and edit phase: everything that changes the scene */
+void
+edit(void)
 {
 	SDL_Event e;
-	while(SDL_PollEvent(&e)) {
+	SDL_PumpEvents();
+	while (next_event(&e)) {
 		switch (e.type) {
 		case SDL_MOUSEMOTION:
 			mousestate = e.motion;
 			mousepos.x = e.motion.x;
 			mousepos.y = e.motion.y;
+			if (e.motion.state & SDL_BUTTON_MMASK) {
+				cam.x -= e.motion.xrel / cam.zoom;
+				cam.y -= e.motion.yrel / cam.zoom;
+				mouse_refresh();
+			}
+			if (drawingcurve)
+				curvepath_add(e.motion.x, e.motion.y);
 			break;
 		case SDL_MOUSEBUTTONDOWN:
+			audio_resume();
+			if (e.button.button == SDL_BUTTON_MIDDLE)
+				break;
+			if (e.button.button == SDL_BUTTON_RIGHT) {
+				if (ismousedown)
+					break;
+				if (SDL_GetModState() & KMOD_SHIFT) {
+					struct curve *curve = curve_at(e.button.x, e.button.y);
+					if (curve)
+						curve_del(curve);
+					break;
+				}
+				int idx = dropper_at(e.button.x, e.button.y);
+				if (idx >= 0)
+					dropper_del(idx);
+				else
+					dropper_add(e.button.x, e.button.y, DROPRATE, 0, 0, 0, simtime);
+				break;
+			}
 			ismousedown = true;
 			mousedown.x = e.button.x;
 			mousedown.y = e.button.y;
 			mousepos.x = e.button.x;
 			mousepos.y = e.button.y;
+			if (SDL_GetModState() & KMOD_SHIFT) {
+				drawingcurve = true;
+				curvepath_len = 0;
+				curvepath_add(e.button.x, e.button.y);
+			}
 			break;
 		case SDL_MOUSEBUTTONUP:
+			if (e.button.button == SDL_BUTTON_RIGHT || e.button.button == SDL_BUTTON_MIDDLE)
+				break;
 			ismousedown = false;
 			mousepos.x = e.button.x;
 			mousepos.y = e.button.y;
-			if (selected) {
-				if (selected_line && INRADIUS(selected_line->start.x - selected_line->end.x, selected_line->start.y - selected_line->end.y, MINLENGTH)) {
+			if (drawingcurve) {
+				drawingcurve = false;
+				curvepath_add(e.button.x, e.button.y);
+				if (!INRADIUS(mousedown.x - e.button.x, mousedown.y - e.button.y, SCREENDIST(MINLENGTH))) {
+					double cx[4], cy[4];
+					curvepath_fit(cx, cy);
+					curve_add(cx, cy);
+				}
+			} else if (selected) {
+				if (selected_line && INRADIUS(selected_line->start.x - selected_line->end.x, selected_line->start.y - selected_line->end.y, SCREENDIST(MINLENGTH))) {
 					line_del(selected_line);
 					selected = NULL;
 				} else {
-					selected->x = e.button.x;
-					selected->y = e.button.y;
+					selected_move(e.button.x, e.button.y);
 					selected = NULL;
 				}
 				selected_line = NULL;
-			} else if (!INRADIUS(mousedown.x - e.button.x, mousedown.y - e.button.y, MINLENGTH)) {
+				selected_dropper = -1;
+			} else if (!INRADIUS(mousedown.x - e.button.x, mousedown.y - e.button.y, SCREENDIST(MINLENGTH))) {
 				line_add(mousedown.x, mousedown.y, e.button.x, e.button.y);
 			}
 			break;
+		case SDL_KEYDOWN:
+			if (e.key.keysym.sym == SDLK_c)
+				ballcollide = !ballcollide;
+			else if (e.key.keysym.sym == SDLK_s)
+				scene_save(scenepath ? scenepath : "scene.txt");
+			else if (e.key.keysym.sym == SDLK_HOME) {
+				cam = (struct camera){ 0, 0, 1 };
+				mouse_refresh();
+			}
+			break;
+		case SDL_MOUSEWHEEL:
+			if (e.wheel.y > 0)
+				camera_zoom(1.25);
+			else if (e.wheel.y < 0)
+				camera_zoom(1 / 1.25);
+			mouse_refresh();
+			break;
 		case SDL_QUIT:
 			running = false;
 		case SDL_WINDOWEVENT: {
@@ -309,96 +1322,429 @@ loop()
 		}
 	}
 
-	now = SDL_GetTicks();
-	if (now - lastdrop >= DROPRATE) {
-		ball_add(dropper.x, dropper.y);
-		lastdrop = now;
+	/* pick what the mouse went down on, preferring line endpoints, and drag it */
+	if (ismousedown && !drawingcurve && !selected) {
+		struct pick *p = pick_find(mousedown.x, mousedown.y, SCREENDIST(PICKRADIUS), false);
+		if (p) {
+			selected_line = p->line;
+			selected = pick_point(p);
+		} else if ((selected_dropper = dropper_at(mousedown.x, mousedown.y)) >= 0) {
+			selected = &droppers[selected_dropper].pos;
+		}
 	}
+	/* a drag that hasn't moved leaves the scene, and its snapshot, alone */
+	if (selected && (selected->x != mousepos.x || selected->y != mousepos.y))
+		selected_move(mousepos.x, mousepos.y);
+}
 
-	delta = now - then;
-	if (delta < 5)
-		return;
-	then = now;
+/* a flattened curve in a scene: its points are npts of the scene's curve
+ * points from first on, within the box x0,y0 to x1,y1 */
+struct polyline {
+	double x0, y0, x1, y1;
+	int first, npts;
+};
 
-	/* update state */
-	for (struct ball *ball = balls_first; ball != NULL; ball = ball->next) {
-		ballrect = (struct SDL_Rect){ball->x - BALL_RADIUS, ball->y - BALL_RADIUS, ball->x + BALL_RADIUS, ball->y + BALL_RADIUS};
-		if (!SDL_HasIntersection(&ballrect, &screenrect)) {
-			ball_del(ball);
-			continue;
-		}
+/* the render phase only sees a snapshot of the scene, taken under the world
+ * lock after editing, so drawing never reads the live scene. the geometry is
+ * only copied again when it has been edited since the last snapshot.
+ * curves are drawn from the same polylines the balls bounce off */
+struct scene {
+	SDL_Point *droppers;
+	struct { SDL_Point start, end; } *lines;
+	struct polyline *curves;
+	double *cpx, *cpy;
+	int ndroppers, nlines, ncurves, ncpts;
+	int dropperscap, linescap, curvescap, cpxcap, cpycap;
+	unsigned int edits;
+
+	bool hover;
+	SDL_Point hoverpt;
+	enum { PREVIEW_NONE, PREVIEW_LINE, PREVIEW_CURVE } preview;
+	SDL_Point from, to;
+	struct polyline previewcurve;
+
+	/* screen coordinates of the polyline being drawn */
+	double *sx;
+	int sxcap;
+
+	struct camera cam;
+	float viewx0, viewy0, viewx1, viewy1;
+};
+
+struct scene scene;
+
+static void *
+reserve(void *p, int *cap, int n, size_t size)
+{
+	if (n <= *cap)
+		return p;
+	while (*cap < n)
+		*cap = *cap ? *cap * 2 : 64;
+	p = realloc(p, *cap * size);
+	if (p == NULL)
+		SDL_Quit();
+	return p;
+}
+
+/* make room for n more curve points, returning where they go */
+static int
+scene_points(struct scene *s, struct polyline *p, int n)
+{
+	s->cpx = reserve(s->cpx, &s->cpxcap, s->ncpts + n, sizeof(*s->cpx));
+	s->cpy = reserve(s->cpy, &s->cpycap, s->ncpts + n, sizeof(*s->cpy));
+	p->first = s->ncpts;
+	p->npts = n;
+	s->ncpts += n;
+	return p->first;
+}
+
+static void
+polyline_box(struct scene *s, struct polyline *p)
+{
+	const double *x = s->cpx + p->first, *y = s->cpy + p->first;
+
+	p->x0 = p->x1 = x[0];
+	p->y0 = p->y1 = y[0];
+	for (int i = 1; i < p->npts; i++) {
+		p->x0 = MIN(p->x0, x[i]);
+		p->x1 = MAX(p->x1, x[i]);
+		p->y0 = MIN(p->y0, y[i]);
+		p->y1 = MAX(p->y1, y[i]);
+	}
+}
 
+void
+scene_snapshot(struct scene *s)
+{
+	double cx[4], cy[4];
+	int first, n;
+
+	if (s->edits != edits) {
+		s->droppers = reserve(s->droppers, &s->dropperscap, droppers_len, sizeof(*s->droppers));
+		for (int i = 0; i < droppers_len; i++)
+			s->droppers[i] = droppers[i].pos;
+		s->ndroppers = droppers_len;
+
+		s->nlines = 0;
 		for (struct line *line = lines_first; line != NULL; line = line->next) {
-			if (ball_bounce(ball, line)) // returns true if it has bounced, can only bounce off of one line.
-				break;
+			s->lines = reserve(s->lines, &s->linescap, s->nlines + 1, sizeof(*s->lines));
+			s->lines[s->nlines].start = line->start;
+			s->lines[s->nlines++].end = line->end;
 		}
 
-		ball_update(ball, delta);
+		s->ncurves = 0;
+		s->ncpts = 0;
+		for (struct curve *curve = curves_first; curve != NULL; curve = curve->next) {
+			s->curves = reserve(s->curves, &s->curvescap, s->ncurves + 1, sizeof(*s->curves));
+			struct polyline *p = &s->curves[s->ncurves++];
+			first = scene_points(s, p, curve->npts);
+			memcpy(s->cpx + first, curve->px, curve->npts * sizeof(*curve->px));
+			memcpy(s->cpy + first, curve->py, curve->npts * sizeof(*curve->py));
+			polyline_box(s, p);
+		}
+		s->edits = edits;
 	}
 
-	/* render */
-	SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-	SDL_RenderClear(ren);
+	struct pick *hover = pick_find(mousepos.x, mousepos.y, SCREENDIST(PICKRADIUS), false);
+	s->hover = hover != NULL;
+	if (hover)
+		s->hoverpt = *pick_point(hover);
+
+	s->cam = cam;
+	s->viewx0 = cam.x;
+	s->viewy0 = cam.y;
+	s->viewx1 = cam.x + screenrect.w / cam.zoom;
+	s->viewy1 = cam.y + screenrect.h / cam.zoom;
+
+	s->preview = PREVIEW_NONE;
+	if (drawingcurve) {
+		/* flattened as curve_add would, just past the curves' points,
+		 * which are kept across snapshots */
+		s->preview = PREVIEW_CURVE;
+		curvepath_fit(cx, cy);
+		n = bezierFlatten(cx, cy, 4, CURVE_TOLERANCE, NULL, NULL, 0);
+		first = scene_points(s, &s->previewcurve, n);
+		s->ncpts -= n;
+		bezierFlatten(cx, cy, 4, CURVE_TOLERANCE, s->cpx + first, s->cpy + first, n);
+		polyline_box(s, &s->previewcurve);
+	} else if (ismousedown && !selected) {
+		s->preview = PREVIEW_LINE;
+		s->from = mousedown;
+		s->to = mousepos;
+	}
+}
+
+/* whether the world box x0,y0 to x1,y1, grown by r, is in view */
+static bool
+visible(const struct scene *s, float x0, float y0, float x1, float y1, float r)
+{
+	return x1 + r > s->viewx0 && x0 - r < s->viewx1 && y1 + r > s->viewy0 && y0 - r < s->viewy1;
+}
 
-	if (ismousedown) {
-		if (!selected && INRADIUS(dropper.x - mousedown.x, dropper.y - mousedown.y, BALL_RADIUS + 5)) {
-			selected = &dropper;
-			old_dropper.x = dropper.x;
-			old_dropper.y = dropper.y;
-			dropper.x = mousepos.x;
-			dropper.y = mousepos.y;
-		} else if (selected == &dropper && INRADIUS(old_dropper.x - mousedown.x, old_dropper.y - mousedown.y, BALL_RADIUS + 5)) {
-			dropper.x = mousepos.x;
-			dropper.y = mousepos.y;
+/* the part t0 to t1 of the world segment from x0,y0 to x1,y1 that lies in
+ * the view grown by r, or false if none does. what is drawn is clipped to
+ * this, so that window coordinates stay near the window however far in it
+ * is zoomed, and fit the 16 bits the primitives take */
+static bool
+clip_segment(const struct scene *s, double r, double x0, double y0, double x1, double y1, double *t0, double *t1)
+{
+	double p[4] = { x0 - x1, x1 - x0, y0 - y1, y1 - y0 };
+	double q[4] = { x0 - (s->viewx0 - r), s->viewx1 + r - x0, y0 - (s->viewy0 - r), s->viewy1 + r - y0 };
+
+	*t0 = 0;
+	*t1 = 1;
+	for (int i = 0; i < 4; i++) {
+		if (p[i] == 0) {
+			if (q[i] < 0)
+				return false;
+		} else if (p[i] < 0) {
+			*t0 = MAX(*t0, q[i] / p[i]);
+		} else {
+			*t1 = MIN(*t1, q[i] / p[i]);
 		}
 	}
+	return *t0 <= *t1;
+}
 
-	aaFilledEllipseColor(ren, dropper.x, dropper.y, BALL_RADIUS + 5, BALL_RADIUS + 5, 0xFFFFFFFF);
-	aaFilledEllipseColor(ren, dropper.x, dropper.y, BALL_RADIUS, BALL_RADIUS, 0xFF000000);
+/* draw the in view part of a world segment */
+static void
+render_line(const struct scene *s, double x0, double y0, double x1, double y1, Uint8 width, Uint32 color)
+{
+	double t0, t1, dx = x1 - x0, dy = y1 - y0;
 
-	SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+	if (!clip_segment(s, (width + 1) / s->cam.zoom, x0, y0, x1, y1, &t0, &t1))
+		return;
+	Sint16 ax = (x0 + t0 * dx - s->cam.x) * s->cam.zoom, ay = (y0 + t0 * dy - s->cam.y) * s->cam.zoom;
+	Sint16 bx = (x0 + t1 * dx - s->cam.x) * s->cam.zoom, by = (y0 + t1 * dy - s->cam.y) * s->cam.zoom;
+	if (width == 1)
+		lineColor(ren, ax, ay, bx, by, color);
+	else
+		thickLineColor(ren, ax, ay, bx, by, width, color);
+}
 
-	for (struct line *line = lines_first; line != NULL; line = line->next) {
-		if (INRADIUS(line->start.x - mousepos.x, line->start.y - mousepos.y, 5)) {
-			aaFilledEllipseColor(ren, line->start.x, line->start.y, 5, 5, 0x80FFFFFF);
-		} else if (INRADIUS(line->end.x - mousepos.x, line->end.y - mousepos.y, 5)) {
-			aaFilledEllipseColor(ren, line->end.x, line->end.y, 5, 5, 0x80FFFFFF);
-		}
+/* draw the n window points gathered of a polyline */
+static int
+render_run(struct scene *s, int n, int npts, Uint32 color)
+{
+	if (n >= 2)
+		aaPolylineColor(ren, s->sx, s->sx + npts, n, 3, color);
+	return 0;
+}
 
-		if (ismousedown) {
-			if (INRADIUS(line->start.x - mousedown.x, line->start.y - mousedown.y, 5)) {
-				selected = &line->start;
-			} else if (INRADIUS(line->end.x - mousedown.x, line->end.y - mousedown.y, 5)) {
-				selected = &line->end;
-			}
-		}
+/* draw a flattened curve, if any of it is in view. each segment is clipped
+ * to the view, and the runs of them that are in view drawn one by one */
+static void
+render_polyline(struct scene *s, const struct polyline *p, Uint32 color)
+{
+	const double *px = s->cpx + p->first, *py = s->cpy + p->first;
+	double t0, t1, r = 4 / s->cam.zoom;
+	int n = 0;
 
-		if (selected == &line->start) {
-			line->start.x = mousepos.x;
-			line->start.y = mousepos.y;
-			selected_line = line;
-		} else if (selected == &line->end) {
-			line->end.x = mousepos.x;
-			line->end.y = mousepos.y;
-			selected_line = line;
+	if (p->npts < 2 || !visible(s, p->x0, p->y0, p->x1, p->y1, 0))
+		return;
+	s->sx = reserve(s->sx, &s->sxcap, 2 * p->npts, sizeof(*s->sx));
+	double *sx = s->sx, *sy = s->sx + p->npts;
+	for (int i = 0; i + 1 < p->npts; i++) {
+		double dx = px[i + 1] - px[i], dy = py[i + 1] - py[i];
+		if (!clip_segment(s, r, px[i], py[i], px[i + 1], py[i + 1], &t0, &t1)) {
+			n = render_run(s, n, p->npts, color);
+			continue;
 		}
-		thickLineColor(ren, line->start.x, line->start.y, line->end.x, line->end.y, 3, 0xFFFFFFFF);
+		if (t0 > 0)
+			n = render_run(s, n, p->npts, color);
+		if (n == 0) {
+			sx[n] = (px[i] + t0 * dx - s->cam.x) * s->cam.zoom;
+			sy[n++] = (py[i] + t0 * dy - s->cam.y) * s->cam.zoom;
+		}
+		sx[n] = (px[i] + t1 * dx - s->cam.x) * s->cam.zoom;
+		sy[n++] = (py[i] + t1 * dy - s->cam.y) * s->cam.zoom;
+		if (t1 < 1)
+			n = render_run(s, n, p->npts, color);
+	}
+	render_run(s, n, p->npts, color);
+}
+
+/* draw from the scene snapshot in world coordinates, through its camera.
+ * anything out of view is skipped */
+void
+render(struct scene *s)
+{
+	const struct camera *c = &s->cam;
+#define SX(v) (((v) - c->x) * c->zoom)
+#define SY(v) (((v) - c->y) * c->zoom)
+
+	SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+	SDL_RenderClear(ren);
+
+	render_line(s, world.x, world.y, world.x + world.w, world.y, 1, 0xFF404040);
+	render_line(s, world.x + world.w, world.y, world.x + world.w, world.y + world.h, 1, 0xFF404040);
+	render_line(s, world.x + world.w, world.y + world.h, world.x, world.y + world.h, 1, 0xFF404040);
+	render_line(s, world.x, world.y + world.h, world.x, world.y, 1, 0xFF404040);
+
+	for (int i = 0; i < s->ndroppers; i++) {
+		SDL_Point *p = &s->droppers[i];
+		if (!visible(s, p->x, p->y, p->x, p->y, DROPPER_RADIUS))
+			continue;
+		aaFilledEllipseColor(ren, SX(p->x), SY(p->y), DROPPER_RADIUS * c->zoom, DROPPER_RADIUS * c->zoom, 0xFFFFFFFF);
+		aaFilledEllipseColor(ren, SX(p->x), SY(p->y), BALL_RADIUS * c->zoom, BALL_RADIUS * c->zoom, 0xFF000000);
 	}
 
-	if (ismousedown && !selected) {
-		thickLineColor(ren, mousedown.x, mousedown.y, mousepos.x, mousepos.y, 3, 0xFFFFFFFF);
+	SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+
+	/* the hover mark is the size of the pick radius, in window pixels */
+	if (s->hover && visible(s, s->hoverpt.x, s->hoverpt.y, s->hoverpt.x, s->hoverpt.y, PICKRADIUS / c->zoom))
+		aaFilledEllipseColor(ren, SX(s->hoverpt.x), SY(s->hoverpt.y), PICKRADIUS, PICKRADIUS, 0x80FFFFFF);
+
+	for (int i = 0; i < s->nlines; i++) {
+		SDL_Point *a = &s->lines[i].start, *b = &s->lines[i].end;
+		render_line(s, a->x, a->y, b->x, b->y, 3, 0xFFFFFFFF);
 	}
 
-	for (struct ball *ball = balls_first; ball != NULL; ball = ball->next) {
-		aaFilledEllipseColor(ren, ball->x, ball->y, BALL_RADIUS, BALL_RADIUS, 0xFFFFFFFF);
+	for (int i = 0; i < s->ncurves; i++)
+		render_polyline(s, &s->curves[i], 0xFFFFFFFF);
+
+	if (s->preview == PREVIEW_CURVE)
+		render_polyline(s, &s->previewcurve, 0x80FFFFFF);
+	else if (s->preview == PREVIEW_LINE)
+		render_line(s, s->from.x, s->from.y, s->to.x, s->to.y, 3, 0xFFFFFFFF);
+
+	struct snapshot *snap = snapshot_acquire();
+	for (int i = 0; i < snap->len; i++) {
+		SDL_FPoint *p = &snap->balls[i];
+		if (!visible(s, p->x, p->y, p->x, p->y, BALL_RADIUS))
+			continue;
+		aaFilledEllipseColor(ren, SX(p->x), SY(p->y), BALL_RADIUS * c->zoom, BALL_RADIUS * c->zoom, 0xFFFFFFFF);
 	}
+#undef SX
+#undef SY
 
 	SDL_RenderPresent(ren);
+	gfxPrimitivesScratchReset();
+	if (!presented) {
+		SDL_Log("startup: first frame after %u ms", SDL_GetTicks());
+		presented = true;
+	}
+}
+
+void
+loop()
+{
+	world_lock();
+	edit();
+	scene_snapshot(&scene);
+	world_unlock();
+
+#ifndef SIMTHREAD
+	advance();
+#endif
+	render(&scene);
+}
+
+/* run the simulation without a window for the given time, writing the audio
+ * it produces to a wav file as fast as it can be synthesized */
+int
+render_offline(const char *wavpath, unsigned int ms)
+{
+	if (audio_offline_open(soundfont, wavpath) < 0)
+		return 1;
+
+	/* only audio up to the last flush is final, later notes are pending */
+	int ret = 0;
+	while (simtime < ms && ret == 0) {
+		step();
+		ret = audio_offline_advance(flushtime);
+	}
+	if (ret == 0) {
+		audio_flush();
+		ret = audio_offline_advance(simtime);
+	}
+
+	audio_offline_close();
+	return ret < 0;
+}
+
+/* run the simulation against the clock without a window for the given time,
+ * reading its snapshots as the renderer would. with SIMTHREAD this exercises
+ * the simulation thread and the handoff, so the threaded web build can be
+ * tested under node */
+int
+run_headless(unsigned int ms)
+{
+	unsigned int start = SDL_GetTicks(), frames = 0, stale = 0, last = 0;
+	int maxballs = 0;
+
+	then = start;
+	if (sim_start() < 0)
+		return 1;
+
+	while (SDL_GetTicks() - start < ms) {
+#ifndef SIMTHREAD
+		advance();
+#endif
+		struct snapshot *s = snapshot_acquire();
+		if (s->simtime == last)
+			stale++;
+		last = s->simtime;
+		maxballs = MAX(maxballs, s->len);
+		frames++;
+		SDL_Delay(16);
+	}
+
+	sim_stop();
+	SDL_Log("headless: %u frames, %u without a new snapshot, simulated %u ms, at most %d balls",
+	        frames, stale, last, maxballs);
+	return 0;
+}
+
+void
+usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-s scene] [-f soundfont] [-w widthxheight] [-o out.wav | -H] [-t seconds]\n", argv0);
+	exit(1);
 }
 
 int
 main(int argc, char *argv[])
 {
+	const char *wavpath = NULL;
+	unsigned int seconds = 30;
+	bool headless = false;
+
+	/* startup times are measured from here */
+	SDL_GetTicks();
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-H") == 0)
+			headless = true;
+		else if (i + 1 == argc)
+			usage(argv[0]);
+		else if (strcmp(argv[i], "-s") == 0)
+			scenepath = argv[++i];
+		else if (strcmp(argv[i], "-f") == 0)
+			soundfont = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0)
+			wavpath = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0)
+			seconds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-w") == 0) {
+			if (sscanf(argv[++i], "%dx%d", &world.w, &world.h) != 2 || world.w <= 0 || world.h <= 0)
+				usage(argv[0]);
+			worldfixed = true;
+		}
+		else
+			usage(argv[0]);
+	}
+
+	if (scenepath == NULL)
+		dropper_add(100, 100, DROPRATE, 0, 0, 0, 0);
+	else if (scene_load(scenepath) < 0)
+		return 1;
+
+	if (wavpath)
+		return render_offline(wavpath, seconds * 1000);
+	if (headless)
+		return run_headless(seconds * 1000);
+
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
 
 #ifdef EMSCRIPTEN
@@ -406,6 +1752,10 @@ main(int argc, char *argv[])
 	emscripten_get_screen_size(&width, &height);
 	screenrect.w = canvas_get_width();
 	screenrect.h = canvas_get_height();
+	if (!worldfixed) {
+		world.w = screenrect.w;
+		world.h = screenrect.h;
+	}
 #endif
 
 	if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER|SDL_INIT_AUDIO) != 0) {
@@ -419,54 +1769,21 @@ main(int argc, char *argv[])
 		goto err1;
 	}
 
-#ifdef SOUND
-	fsettings = new_fluid_settings();
-	if (!fsettings) {
-		SDL_Log("Unable to create fluid settings");
+	if (audio_init(soundfont) < 0)
 		goto err2;
-	}
-
-	fsynth = new_fluid_synth(fsettings);
-	if (!fsynth) {
-		SDL_Log("Unable to create fluid synth");
-		goto err3;
-	}
-
-	if ((sfid = fluid_synth_sfload(fsynth, "assets/Xylophone-MediumMallets-20200706.sf2", true)) == FLUID_FAILED) {
-		SDL_Log("Unable to load soundfont");
-		goto err4;
-	}
-
-	fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(fsynth, sfid);
-	if (sfont == NULL) {
-		SDL_Log("coudn't load sfont by id");
-		return 1;
-	}
-
-	fluid_sfont_iteration_start(sfont);
-	fluid_preset_t *fpreset = fluid_sfont_iteration_next(sfont);
-	int bank = fluid_preset_get_banknum(fpreset);
-	int prog = fluid_preset_get_num(fpreset);
-	fluid_synth_activate_tuning(fsynth, 0, bank, prog, true);
-
-	fluid_settings_setstr(fsettings, "audio.driver", "sdl2");
-	fadriver = new_fluid_audio_driver(fsettings, fsynth);
-	if (!fadriver) {
-		SDL_Log("Unable to create fluid synth driver");
-		goto err5;
-	}
-#endif
 
 	ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
 	if (ren == NULL) {
 		SDL_Log("Unable to create renderer: %s", SDL_GetError());
-		goto err6;
+		goto err3;
 	}
 
 	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
 
 	then = SDL_GetTicks();
 	running = true;
+	if (sim_start() < 0)
+		goto err4;
 
 #ifdef EMSCRIPTEN
 	emscripten_set_main_loop(&loop, 0, 1);
@@ -475,20 +1792,14 @@ main(int argc, char *argv[])
 		loop();
 	}
 #endif
+	sim_stop();
+	gfxPrimitivesScratchFree();
 
-err7:
-	SDL_DestroyRenderer(ren);
-err6:
-#ifdef SOUND
-	delete_fluid_audio_driver(fadriver);
-err5:
-	fluid_synth_sfunload(fsynth, sfid, true);
 err4:
-	delete_fluid_synth(fsynth);
+	SDL_DestroyRenderer(ren);
 err3:
-	delete_fluid_settings(fsettings);
+	audio_quit();
 err2:
-#endif
 	SDL_DestroyWindow(win);
 err1:
 	SDL_Quit();
@@ -0,0 +1,154 @@
+/*
+
+rotozoomtest.c: checks that the vector bilinear kernels of SDL2_rotozoom
+produce exactly the same bytes as the scalar one
+
+The kernels are static, so the library is compiled into the test.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SDL2_rotozoom.c"
+
+typedef void (*tBilinearFunc)(const tBilinearChunk *ch, tColorRGBA *dp, int n);
+
+static Uint32 _seed = 1;
+
+static Uint32 _random()
+{
+	_seed = _seed * 1103515245 + 12345;
+	return _seed >> 8;
+}
+
+static void _fillRandom(void *p, size_t len)
+{
+	Uint8 *b = (Uint8 *) p;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		b[i] = (Uint8) _random();
+	}
+}
+
+/*!
+\brief Runs a kernel on random chunks of every length against the scalar kernel.
+
+\returns The number of chunks that differ.
+*/
+static int _testChunks(const char *name, tBilinearFunc kernel)
+{
+	tBilinearChunk ch;
+	tColorRGBA want[BILINEAR_CHUNK], got[BILINEAR_CHUNK];
+	int n, round, fails = 0;
+
+	for (round = 0; round < 2000; round++) {
+		_fillRandom(&ch, sizeof(ch));
+		/* Make sure the extremes of the weights are covered */
+		if (round % 4 == 1) {
+			memset(ch.ex, 0xff, sizeof(ch.ex));
+		} else if (round % 4 == 2) {
+			memset(ch.ey, 0, sizeof(ch.ey));
+		}
+		for (n = 0; n <= BILINEAR_CHUNK; n++) {
+			memset(want, 0, sizeof(want));
+			memset(got, 0, sizeof(got));
+			_bilinearScalar(&ch, want, 0, n);
+			kernel(&ch, got, n);
+			if (memcmp(want, got, sizeof(want)) != 0) {
+				if (fails == 0) {
+					fprintf(stderr, "%s: chunk of %d pixels differs in round %d\n", name, n, round);
+				}
+				fails++;
+			}
+		}
+	}
+	return fails;
+}
+
+static int _sameSurface(SDL_Surface *a, SDL_Surface *b)
+{
+	int y;
+
+	if (a == NULL || b == NULL || a->w != b->w || a->h != b->h) {
+		return 0;
+	}
+	for (y = 0; y < a->h; y++) {
+		if (memcmp((Uint8 *) a->pixels + y * a->pitch, (Uint8 *) b->pixels + y * b->pitch, a->w * 4) != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*!
+\brief Zooms and rotozooms random surfaces with a kernel and with the scalar kernel.
+
+\returns The number of results that differ.
+*/
+static int _testSurfaces(const char *name, tBilinearFunc kernel)
+{
+	static const int sizes[][2] = {{1, 1}, {3, 2}, {17, 9}, {64, 64}, {301, 199}};
+	static const double zooms[][2] = {{1, 1}, {2.5, 2.5}, {0.7, 1.9}, {-1.3, 0.8}};
+	static const double angles[] = {0, 17, 90, -133.5};
+	SDL_Surface *src, *want, *got;
+	int i, z, a, fails = 0;
+
+	for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		src = SDL_CreateRGBSurface(0, sizes[i][0], sizes[i][1], 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+		if (src == NULL) {
+			fprintf(stderr, "%s: %s\n", name, SDL_GetError());
+			return 1;
+		}
+		_fillRandom(src->pixels, src->h * src->pitch);
+		for (z = 0; z < (int) (sizeof(zooms) / sizeof(zooms[0])); z++) {
+			for (a = -1; a < (int) (sizeof(angles) / sizeof(angles[0])); a++) {
+				_bilinear = _bilinearPortable;
+				want = a < 0 ? zoomSurface(src, zooms[z][0], zooms[z][1], SMOOTHING_ON) :
+					rotozoomSurfaceXY(src, angles[a], zooms[z][0], zooms[z][1], SMOOTHING_ON);
+				_bilinear = kernel;
+				got = a < 0 ? zoomSurface(src, zooms[z][0], zooms[z][1], SMOOTHING_ON) :
+					rotozoomSurfaceXY(src, angles[a], zooms[z][0], zooms[z][1], SMOOTHING_ON);
+				if (!_sameSurface(want, got)) {
+					if (fails == 0) {
+						fprintf(stderr, "%s: %dx%d surface differs at zoom %g,%g angle %g\n", name,
+							sizes[i][0], sizes[i][1], zooms[z][0], zooms[z][1], a < 0 ? 0 : angles[a]);
+					}
+					fails++;
+				}
+				SDL_FreeSurface(want);
+				SDL_FreeSurface(got);
+			}
+		}
+		SDL_FreeSurface(src);
+	}
+	return fails;
+}
+
+static int _test(const char *name, tBilinearFunc kernel)
+{
+	int fails = _testChunks(name, kernel) + _testSurfaces(name, kernel);
+
+	printf("%s: %s\n", name, fails ? "FAIL" : "ok");
+	return fails;
+}
+
+int main(void)
+{
+	int fails = 0;
+
+	fails += _test("scalar", _bilinearPortable);
+#if defined(ROTOZOOM_SSE2)
+	fails += _test("sse2", _bilinearSSE2);
+#endif
+#if defined(ROTOZOOM_AVX2)
+	if (SDL_HasAVX2()) {
+		fails += _test("avx2", _bilinearAVX2);
+	} else {
+		printf("avx2: skipped, not supported by this CPU\n");
+	}
+#endif
+
+	return fails != 0;
+}
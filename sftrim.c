@@ -0,0 +1,408 @@
+/* sftrim: writes a soundfont holding only what the game can play: the preset
+ * the synth plays, bank 0 program 0, the zones of it reachable from play_vec()'s keys and
+ * velocities, and the samples those zones use */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* record sizes of the pdta sub-chunks */
+#define PHDR 38
+#define BAG 4
+#define MOD 10
+#define GEN 4
+#define INST 22
+#define SHDR 46
+
+/* generators */
+#define GEN_INSTRUMENT 41
+#define GEN_KEYRANGE 43
+#define GEN_VELRANGE 44
+#define GEN_SAMPLEID 53
+
+/* zero points the spec requires after each sample */
+#define SAMPLEPAD 46
+
+struct chunk {
+	const uint8_t *p;
+	uint32_t len;
+};
+
+struct buf {
+	uint8_t *p;
+	size_t len, cap;
+};
+
+static struct chunk info, smpl, phdr, pbag, pmod, pgen, inst, ibag, imod, igen, shdr;
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "sftrim: %s\n", msg);
+	exit(1);
+}
+
+static int
+rd16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t
+rd32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void
+put(struct buf *b, const void *p, size_t len)
+{
+	if (len == 0)
+		return;
+	if (b->len + len > b->cap) {
+		while (b->len + len > b->cap)
+			b->cap = b->cap ? b->cap * 2 : 4096;
+		b->p = realloc(b->p, b->cap);
+		if (b->p == NULL)
+			die("out of memory");
+	}
+	if (p)
+		memcpy(b->p + b->len, p, len);
+	else
+		memset(b->p + b->len, 0, len);
+	b->len += len;
+}
+
+static void
+put16(struct buf *b, unsigned int v)
+{
+	uint8_t p[2] = { v, v >> 8 };
+	put(b, p, 2);
+}
+
+static void
+put32(struct buf *b, uint32_t v)
+{
+	uint8_t p[4] = { v, v >> 8, v >> 16, v >> 24 };
+	put(b, p, 4);
+}
+
+static void
+putchunk(struct buf *b, const char *id, const struct buf *data)
+{
+	put(b, id, 4);
+	put32(b, data->len);
+	put(b, data->p, data->len);
+	if (data->len & 1)
+		put(b, NULL, 1);
+}
+
+/* walks the sub-chunks of a LIST, recording the ones we use */
+static void
+parse_list(const uint8_t *p, uint32_t len)
+{
+	const char *type = (const char *)p;
+	const uint8_t *end = p + len;
+
+	for (p += 4; p + 8 <= end; p += 8 + ((rd32(p + 4) + 1) & ~1u)) {
+		struct chunk c = { p + 8, rd32(p + 4) };
+		if (c.p + c.len > end)
+			die("truncated chunk");
+
+		if (strncmp(type, "sdta", 4) == 0 && memcmp(p, "smpl", 4) == 0)
+			smpl = c;
+		else if (strncmp(type, "pdta", 4) == 0) {
+			struct { const char *id; struct chunk *c; } ids[] = {
+				{ "phdr", &phdr }, { "pbag", &pbag }, { "pmod", &pmod },
+				{ "pgen", &pgen }, { "inst", &inst }, { "ibag", &ibag },
+				{ "imod", &imod }, { "igen", &igen }, { "shdr", &shdr },
+			};
+			for (size_t i = 0; i < sizeof(ids) / sizeof(*ids); i++)
+				if (memcmp(p, ids[i].id, 4) == 0)
+					*ids[i].c = c;
+		}
+	}
+}
+
+/* the key and velocity ranges of a zone, and the instrument or sample it
+ * points to, or -1 for a global zone */
+struct zone {
+	int klo, khi, vlo, vhi;
+	int target;
+};
+
+static struct zone
+zone_get(const struct chunk *bags, const struct chunk *gens, int z, int targetgen)
+{
+	struct zone zone = { 0, 127, 0, 127, -1 };
+	int first = rd16(bags->p + z*BAG), last = rd16(bags->p + (z + 1)*BAG);
+
+	if (last > (int)(gens->len / GEN))
+		die("generator index out of range");
+	for (int g = first; g < last; g++) {
+		const uint8_t *gen = gens->p + g*GEN;
+		switch (rd16(gen)) {
+		case GEN_KEYRANGE:
+			zone.klo = gen[2];
+			zone.khi = gen[3];
+			break;
+		case GEN_VELRANGE:
+			zone.vlo = gen[2];
+			zone.vhi = gen[3];
+			break;
+		default:
+			if (rd16(gen) == targetgen)
+				zone.target = rd16(gen + 2);
+		}
+	}
+	return zone;
+}
+
+static int
+reachable(const struct zone *zone)
+{
+	return zone->klo <= HIGHEST && zone->khi >= LOWEST && zone->vhi >= VELOCITY;
+}
+
+/* copies a zone's generators and modulators, pointing its instrument or
+ * sample at its new index, and adds its bag */
+static void
+zone_copy(struct buf *bags, struct buf *gens, struct buf *mods,
+          const struct chunk *obags, const struct chunk *ogens, const struct chunk *omods,
+          int z, int targetgen, const int *remap)
+{
+	int gfirst = rd16(obags->p + z*BAG), glast = rd16(obags->p + (z + 1)*BAG);
+	int mfirst = rd16(obags->p + z*BAG + 2), mlast = rd16(obags->p + (z + 1)*BAG + 2);
+
+	if (mlast > (int)(omods->len / MOD))
+		die("modulator index out of range");
+	put16(bags, gens->len / GEN);
+	put16(bags, mods->len / MOD);
+	for (int g = gfirst; g < glast; g++) {
+		const uint8_t *gen = ogens->p + g*GEN;
+		put16(gens, rd16(gen));
+		put16(gens, rd16(gen) == targetgen ? remap[rd16(gen + 2)] : rd16(gen + 2));
+	}
+	put(mods, omods->p + mfirst*MOD, (mlast - mfirst)*MOD);
+}
+
+static void
+terminal(struct buf *b, const char *name, size_t len)
+{
+	char rec[64] = { 0 };
+	strncpy(rec, name, 20);
+	put(b, rec, len);
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s in.sf2 out.sf2\n", argv[0]);
+		return 1;
+	}
+
+	FILE *f = fopen(argv[1], "rb");
+	if (f == NULL)
+		die("unable to open input");
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	rewind(f);
+	if (size < 0)
+		die("unable to read input");
+	uint8_t *file = malloc(size);
+	if (file == NULL || fread(file, 1, size, f) != (size_t)size)
+		die("unable to read input");
+	fclose(f);
+
+	if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "sfbk", 4) != 0)
+		die("not a soundfont");
+	const uint8_t *end = file + MIN(size, 8 + rd32(file + 4));
+	for (const uint8_t *p = file + 12; p + 8 <= end; p += 8 + ((rd32(p + 4) + 1) & ~1u)) {
+		if (p + 8 + rd32(p + 4) > end)
+			die("truncated chunk");
+		if (memcmp(p, "LIST", 4) != 0)
+			continue;
+		if (memcmp(p + 8, "INFO", 4) == 0)
+			info = (struct chunk){ p, 8 + rd32(p + 4) };
+		parse_list(p + 8, rd32(p + 4));
+	}
+	if (!info.p || !smpl.p || !phdr.p || !pbag.p || !pmod.p || !pgen.p ||
+	    !inst.p || !ibag.p || !imod.p || !igen.p || !shdr.p)
+		die("missing chunks");
+
+	int npresets = phdr.len / PHDR - 1, ninst = inst.len / INST - 1, nsamples = shdr.len / SHDR - 1;
+	if (npresets < 1 || ninst < 1 || nsamples < 1)
+		die("empty soundfont");
+
+	/* the channels are never given a program, so the synth plays bank 0
+	 * program 0, and nothing at all if the soundfont lacks it */
+	int preset = -1;
+	for (int i = 0; i < npresets && preset < 0; i++)
+		if (rd16(phdr.p + i*PHDR + 22) == 0 && rd16(phdr.p + i*PHDR + 20) == 0)
+			preset = i;
+	if (preset < 0)
+		die("no preset at bank 0 program 0");
+
+	int *instmap = malloc(ninst * sizeof(*instmap));
+	int *samplemap = malloc(nsamples * sizeof(*samplemap));
+	char *keepzone = calloc(ibag.len / BAG, 1);
+	if (!instmap || !samplemap || !keepzone)
+		die("out of memory");
+	memset(instmap, -1, ninst * sizeof(*instmap));
+	memset(samplemap, -1, nsamples * sizeof(*samplemap));
+
+	/* mark the reachable preset zones' instruments, and their reachable
+	 * zones' samples. a zone without a target is global, and always kept */
+	int pfirst = rd16(phdr.p + preset*PHDR + 24), plast = rd16(phdr.p + (preset + 1)*PHDR + 24);
+	if (plast >= (int)(pbag.len / BAG))
+		die("bag index out of range");
+	for (int z = pfirst; z < plast; z++) {
+		struct zone pz = zone_get(&pbag, &pgen, z, GEN_INSTRUMENT);
+		if (pz.target < 0 || !reachable(&pz))
+			continue;
+		if (pz.target >= ninst)
+			die("instrument index out of range");
+		instmap[pz.target] = 0;
+
+		int ifirst = rd16(inst.p + pz.target*INST + 20), ilast = rd16(inst.p + (pz.target + 1)*INST + 20);
+		if (ilast >= (int)(ibag.len / BAG))
+			die("bag index out of range");
+		for (int iz = ifirst; iz < ilast; iz++) {
+			struct zone zone = zone_get(&ibag, &igen, iz, GEN_SAMPLEID);
+			if (zone.target >= 0 && !reachable(&zone))
+				continue;
+			keepzone[iz] = 1;
+			if (zone.target >= nsamples)
+				die("sample index out of range");
+			if (zone.target >= 0)
+				samplemap[zone.target] = 0;
+		}
+	}
+
+	/* stereo samples bring their other half along */
+	for (int s = 0; s < nsamples; s++) {
+		const uint8_t *sh = shdr.p + s*SHDR;
+		int type = rd16(sh + 44) & 0x7FFF, link = rd16(sh + 42);
+		if (samplemap[s] == 0 && type != 1 && link < nsamples)
+			samplemap[link] = 0;
+	}
+
+	/* renumber what is kept, in the original order */
+	int nkeptinst = 0, nkeptsamples = 0;
+	for (int i = 0; i < ninst; i++)
+		if (instmap[i] == 0)
+			instmap[i] = nkeptinst++;
+	for (int s = 0; s < nsamples; s++)
+		if (samplemap[s] == 0)
+			samplemap[s] = nkeptsamples++;
+
+	struct buf obuf = { 0 };
+	struct buf sdata = { 0 }, ophdr = { 0 }, opbag = { 0 }, opmod = { 0 }, opgen = { 0 };
+	struct buf oinst = { 0 }, oibag = { 0 }, oimod = { 0 }, oigen = { 0 }, oshdr = { 0 };
+
+	/* sample data, each followed by the padding the spec requires */
+	for (int s = 0; s < nsamples; s++) {
+		if (samplemap[s] < 0)
+			continue;
+		const uint8_t *sh = shdr.p + s*SHDR;
+		uint32_t start = rd32(sh + 20), stop = rd32(sh + 24);
+		if (stop < start || stop * 2 > smpl.len)
+			die("sample out of range");
+		uint32_t at = sdata.len / 2;
+
+		put(&sdata, smpl.p + start*2, (stop - start)*2);
+		put(&sdata, NULL, SAMPLEPAD*2);
+
+		put(&oshdr, sh, 20);
+		put32(&oshdr, at);
+		put32(&oshdr, at + stop - start);
+		put32(&oshdr, rd32(sh + 28) - start + at);
+		put32(&oshdr, rd32(sh + 32) - start + at);
+		/* a sample whose other half was dropped becomes mono, linking to
+		 * itself, keeping the rom flag */
+		int link = rd16(sh + 42), type = rd16(sh + 44);
+		if (link < nsamples && samplemap[link] >= 0)
+			link = samplemap[link];
+		else {
+			link = samplemap[s];
+			type = (type & 0x8000) | 1;
+		}
+		put(&oshdr, sh + 36, 6);
+		put16(&oshdr, link);
+		put16(&oshdr, type);
+	}
+	terminal(&oshdr, "EOS", SHDR);
+
+	/* the preset and its reachable zones */
+	put(&ophdr, phdr.p + preset*PHDR, 24);
+	put16(&ophdr, 0);
+	put(&ophdr, phdr.p + preset*PHDR + 26, 12);
+	for (int z = pfirst; z < plast; z++) {
+		struct zone pz = zone_get(&pbag, &pgen, z, GEN_INSTRUMENT);
+		if (pz.target < 0 || reachable(&pz))
+			zone_copy(&opbag, &opgen, &opmod, &pbag, &pgen, &pmod, z, GEN_INSTRUMENT, instmap);
+	}
+	terminal(&ophdr, "EOP", PHDR);
+	ophdr.p[ophdr.len - PHDR + 24] = opbag.len / BAG;
+	ophdr.p[ophdr.len - PHDR + 25] = (opbag.len / BAG) >> 8;
+	put16(&opbag, opgen.len / GEN);
+	put16(&opbag, opmod.len / MOD);
+	put(&opgen, NULL, GEN);
+	put(&opmod, NULL, MOD);
+
+	/* the instruments and their kept zones */
+	for (int i = 0; i < ninst; i++) {
+		if (instmap[i] < 0)
+			continue;
+		put(&oinst, inst.p + i*INST, 20);
+		put16(&oinst, oibag.len / BAG);
+		for (int iz = rd16(inst.p + i*INST + 20); iz < rd16(inst.p + (i + 1)*INST + 20); iz++)
+			if (keepzone[iz])
+				zone_copy(&oibag, &oigen, &oimod, &ibag, &igen, &imod, iz, GEN_SAMPLEID, samplemap);
+	}
+	terminal(&oinst, "EOI", INST);
+	oinst.p[oinst.len - 2] = oibag.len / BAG;
+	oinst.p[oinst.len - 1] = (oibag.len / BAG) >> 8;
+	put16(&oibag, oigen.len / GEN);
+	put16(&oibag, oimod.len / MOD);
+	put(&oigen, NULL, GEN);
+	put(&oimod, NULL, MOD);
+
+	/* sm24 is dropped, leaving 16-bit samples */
+	struct buf sdta = { 0 }, pdta = { 0 };
+	put(&sdta, "sdta", 4);
+	putchunk(&sdta, "smpl", &sdata);
+	put(&pdta, "pdta", 4);
+	putchunk(&pdta, "phdr", &ophdr);
+	putchunk(&pdta, "pbag", &opbag);
+	putchunk(&pdta, "pmod", &opmod);
+	putchunk(&pdta, "pgen", &opgen);
+	putchunk(&pdta, "inst", &oinst);
+	putchunk(&pdta, "ibag", &oibag);
+	putchunk(&pdta, "imod", &oimod);
+	putchunk(&pdta, "igen", &oigen);
+	putchunk(&pdta, "shdr", &oshdr);
+
+	put(&obuf, "RIFF", 4);
+	put32(&obuf, 0);
+	put(&obuf, "sfbk", 4);
+	put(&obuf, info.p, info.len + (info.len & 1));
+	putchunk(&obuf, "LIST", &sdta);
+	putchunk(&obuf, "LIST", &pdta);
+	obuf.p[4] = (obuf.len - 8);
+	obuf.p[5] = (obuf.len - 8) >> 8;
+	obuf.p[6] = (obuf.len - 8) >> 16;
+	obuf.p[7] = (obuf.len - 8) >> 24;
+
+	f = fopen(argv[2], "wb");
+	if (f == NULL || fwrite(obuf.p, 1, obuf.len, f) != obuf.len || fclose(f) != 0)
+		die("unable to write output");
+
+	printf("%s: kept %d of %d instruments, %d of %d samples, %ld of %ld bytes\n",
+	       argv[2], nkeptinst, ninst, nkeptsamples, nsamples, (long)obuf.len, size);
+	return 0;
+}